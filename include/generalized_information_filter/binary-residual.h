@@ -1,7 +1,10 @@
 #ifndef GIF_BINARYRESIDUAL_HPP_
 #define GIF_BINARYRESIDUAL_HPP_
 
+#include <atomic>
+
 #include "generalized_information_filter/common.h"
+#include "generalized_information_filter/measurement.h"
 #include "generalized_information_filter/model.h"
 
 namespace GIF {
@@ -11,12 +14,24 @@ namespace GIF {
  */
 class BinaryResidualBase {
  public:
+  /*! \brief Structure of the noise covariance. Cross-covariances between different noise elements
+   *         are never considered, NOISE_DIAGONAL additionally only uses the diagonal entries. The
+   *         latter requires the noise covariance to be diagonal, off-diagonal entries would be
+   *         silently dropped (checked by the filter in debug builds).
+   */
+  enum NoiseStructure {
+    NOISE_BLOCK_DIAGONAL,
+    NOISE_DIAGONAL
+  };
   typedef std::shared_ptr<BinaryResidualBase> Ptr;
   typedef std::shared_ptr<const BinaryResidualBase> CPtr;
   BinaryResidualBase(const std::string& name, bool isUnary = false, bool isSplitable = false, bool isMergeable = false)
       : isUnary_(isUnary), isSplitable_(isSplitable), isMergeable_(isMergeable){
     dt_ = 0.1;
     name_ = name;
+    noiseStructure_ = NOISE_BLOCK_DIAGONAL;
+    isRandomWalk_ = false;
+    inputVersion_ = 0;
   }
   virtual ~BinaryResidualBase() {
   }
@@ -24,6 +39,13 @@ class BinaryResidualBase {
                     const ElementVectorBase& pre,
                     const ElementVectorBase& cur,
                     const ElementVectorBase& noi) const = 0;
+  /*! \brief Evaluates the innovation and all three Jacobians in a single pass. Returns false if the
+   *         residual does not implement a fused version (then the individual calls must be used).
+   */
+  virtual bool EvalWithJacobians(ElementVectorBase* inn, MatX& JPre, MatX& JCur, MatX& JNoi,
+                                 const ElementVectorBase& pre,
+                                 const ElementVectorBase& cur,
+                                 const ElementVectorBase& noi) const = 0;
   virtual void JacPre(MatX& J,
                       const ElementVectorBase& pre,
                       const ElementVectorBase& cur,
@@ -50,10 +72,52 @@ class BinaryResidualBase {
       const ElementVectorBase::CPtr& in1,
       const ElementVectorBase::CPtr& in2,
       ElementVectorBase::CPtr& out) const = 0;
+  /*! \brief Batched version of SplitMeasurements. Splits the measurement in, covering (t0,
+   *         times.back()], at all other (sorted) times. out receives one measurement per time. The
+   *         default falls back to pairwise splitting.
+   */
+  virtual void SplitMeasurementRun(
+      const TimePoint& t0, const std::vector<TimePoint>& times,
+      const ElementVectorBase::CPtr& in,
+      std::vector<ElementVectorBase::CPtr>& out) const {
+    out.resize(times.size());
+    ElementVectorBase::CPtr remainder = in;
+    TimePoint previous = t0;
+    for (int j = 0; j + 1 < times.size(); j++) {
+      SplitMeasurements(previous, times[j], times.back(), remainder, out[j], remainder);
+      previous = times[j];
+    }
+    out.back() = remainder;
+  }
+  /*! \brief Batched version of MergeMeasurements. Merges the measurements in (at the sorted times,
+   *         the first one covering from t0 on) into a single one at times.back(). The default falls
+   *         back to pairwise merging, residuals customizing MergeMeasurements should override both.
+   */
+  virtual void MergeMeasurementRun(
+      const TimePoint& t0, const std::vector<TimePoint>& times,
+      const std::vector<ElementVectorBase::CPtr>& in,
+      ElementVectorBase::CPtr& out) const {
+    out = in.front();
+    for (int j = 0; j + 1 < times.size(); j++) {
+      MergeMeasurements(t0, times[j], times[j + 1], out, in[j + 1], out);
+    }
+  }
   virtual void SetMeas(const ElementVectorBase::CPtr& meas) = 0;
   void SetDt(double dt){
     dt_ = dt;
   }
+  /*! \brief Sets the version of the current inputs (states, noise, measurement and dt). Calls
+   *         with the same non-zero version are assumed to have identical inputs, which allows
+   *         caching of intermediate results between Eval and the Jacobians. 0 disables caching.
+   */
+  void SetInputVersion(unsigned long version){
+    inputVersion_ = version;
+  }
+  // Returns a new globally unique input version (residuals may be shared between filters)
+  static unsigned long NewInputVersion(){
+    static std::atomic<unsigned long> counter(0);
+    return ++counter;
+  }
   virtual bool CheckMeasType(const ElementVectorBase::CPtr& meas) const = 0;
   virtual const MatX& GetNoiseCovariance() const = 0;
   virtual MatX& GetNoiseCovariance() = 0;
@@ -71,6 +135,13 @@ class BinaryResidualBase {
   const bool isMergeable_;
   double dt_;
   std::string name_;
+  NoiseStructure noiseStructure_;
+  /*! \brief Structural property declared by the residual: the noise and previous state have the
+   *         same layout and Jnoi = sqrt(dt)*Jpre. The filter then uses Jpre^T*inv(W)*Jpre =
+   *         inv(dt*R) without evaluating the product (diagonal noise only).
+   */
+  bool isRandomWalk_;
+  unsigned long inputVersion_;
 
   virtual double GetNoiseWeighting(const ElementVector& inn, int i){
     return 1.0;
@@ -96,6 +167,9 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
       ElementPack<Noi...>, Meas> mtBinaryRedidual;
   using mtBase = Model<mtBinaryRedidual,ElementPack<Inn...>,ElementPack<Pre...>,ElementPack<Cur...>,
       ElementPack<Noi...>>;
+  typedef Mat<ElementPack<Inn...>::kDim, ElementPack<Pre...>::kDim> JacPreMat;
+  typedef Mat<ElementPack<Inn...>::kDim, ElementPack<Cur...>::kDim> JacCurMat;
+  typedef Mat<ElementPack<Inn...>::kDim, ElementPack<Noi...>::kDim> JacNoiMat;
   BinaryResidual(const std::string& name,
                  const std::array<std::string, ElementPack<Inn...>::n_>& namesInn,
                  const std::array<std::string, ElementPack<Pre...>::n_>& namesPre,
@@ -104,9 +178,14 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
                  bool isUnary, bool isSplitable, bool isMergeable)
         : mtBase(namesInn, std::forward_as_tuple(namesPre, namesCur, namesNoi)),
           BinaryResidualBase(name, isUnary, isSplitable, isMergeable),
-          meas_(new Meas()) {
+          meas_(new Meas()),
+          isVectorSpaceMeas_(true) {
     R_.resize(NoiDefinition()->GetDim(), NoiDefinition()->GetDim());
     R_.setIdentity();
+    const ElementVectorDefinition& measDefinition = *meas_->GetDefinition();
+    for (int i = 0; i < measDefinition.GetNumElements(); i++) {
+      isVectorSpaceMeas_ &= measDefinition.GetElementDescription(i)->IsVectorSpace();
+    }
   }
   virtual ~BinaryResidual() {
   }
@@ -140,7 +219,7 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
                          const ElementVectorBase::CPtr& in2,
                          ElementVectorBase::CPtr& out) const {
     if (isMergeable_) {
-      ElementVectorBase::Ptr newMeas(new Meas());
+      ElementVectorBase::Ptr newMeas = MeasurementPool<Meas>::Get();
       VecX diff(in1->GetDim());
       in1->BoxMinus(*in2, diff);
       in2->BoxPlus(toSec(t1 - t0) / toSec(t2 - t0) * diff, newMeas.get());
@@ -150,8 +229,52 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
     }
   }
 
-  // User implementations
+  void SplitMeasurementRun(const TimePoint& t0, const std::vector<TimePoint>& times,
+                           const ElementVectorBase::CPtr& in,
+                           std::vector<ElementVectorBase::CPtr>& out) const {
+    if (isSplitable_) {
+      out.assign(times.size(), in);
+    } else {
+      LOG(ERROR) << "Splitting of specific residual not supported/implemented!";
+    }
+  }
+
+  /* Time-weighted mean of the whole run in a single pass. This is only exact on vector spaces, on
+   * manifolds (e.g. quaternions) the mean in the tangent space of the last measurement differs
+   * from the pairwise merge, such measurements fall back to the latter.
+   */
+  void MergeMeasurementRun(const TimePoint& t0, const std::vector<TimePoint>& times,
+                           const std::vector<ElementVectorBase::CPtr>& in,
+                           ElementVectorBase::CPtr& out) const {
+    if (isMergeable_ && !isVectorSpaceMeas_) {
+      BinaryResidualBase::MergeMeasurementRun(t0, times, in, out);
+    } else if (isMergeable_) {
+      const ElementVectorBase::CPtr& last = in.back();
+      VecX diff(last->GetDim());
+      VecX meanDiff(last->GetDim());
+      meanDiff.setZero();
+      TimePoint previous = t0;
+      for (int j = 0; j + 1 < times.size(); j++) {
+        in[j]->BoxMinus(*last, diff);
+        meanDiff += toSec(times[j] - previous) * diff;
+        previous = times[j];
+      }
+      ElementVectorBase::Ptr newMeas = MeasurementPool<Meas>::Get();
+      last->BoxPlus(meanDiff / toSec(times.back() - t0), newMeas.get());
+      out = newMeas;
+    } else {
+      LOG(ERROR) << "Merging of specific residual not supported/implemented!";
+    }
+  }
+
+  // User implementations (see FixedSizeJacobians for implementing the Jacobians on fixed-size
+  // matrices)
   virtual void Eval(Inn&... inn, const Pre&... pre, const Cur&... cur, const Noi&... noi) const = 0;
+  // Optional fused evaluation of innovation and Jacobians (return true if implemented)
+  virtual bool EvalWithJacobians(MatX& JPre, MatX& JCur, MatX& JNoi, Inn&... inn,
+                                 const Pre&... pre, const Cur&... cur, const Noi&... noi) const {
+    return false;
+  }
   virtual void JacPre(MatX& J,   const Pre&... pre, const Cur&... cur, const Noi&... noi) const = 0;
   virtual void JacCur(MatX& J,   const Pre&... pre, const Cur&... cur, const Noi&... noi) const = 0;
   virtual void JacNoi(MatX& J,   const Pre&... pre, const Cur&... cur, const Noi&... noi) const = 0;
@@ -165,6 +288,15 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
     this->EvalWrapper(inn, ins);
   }
 
+  inline bool EvalWithJacobians(ElementVectorBase* inn, MatX& JPre, MatX& JCur, MatX& JNoi,
+                                const ElementVectorBase& pre,
+                                const ElementVectorBase& cur,
+                                const ElementVectorBase& noi) const {
+    const std::array<MatX*, 3> J = {&JPre, &JCur, &JNoi};
+    const std::array<const ElementVectorBase*, 3> ins = {&pre, &cur, &noi};
+    return this->EvalJacWrapper(inn, J, ins);
+  }
+
   inline void JacPre(MatX& J, const ElementVectorBase& pre,
                        const ElementVectorBase& cur,
                        const ElementVectorBase& noi) const {
@@ -225,6 +357,34 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
     return this->template GetJacBlockImpl<2, n, m>(J);
   }
 
+  // Fixed-size block access for the fixed-size Jacobian implementations
+  template<int n, int m>
+  inline Eigen::Block<JacPreMat, ElementPack<Inn...>::template _GetStateDimension<n>(),
+         ElementPack<Pre...>::template _GetStateDimension<m>()> GetJacBlockPre(JacPreMat& J) const {
+    return J.template block<ElementPack<Inn...>::template _GetStateDimension<n>(),
+        ElementPack<Pre...>::template _GetStateDimension<m>()>(
+            ElementPack<Inn...>::template _GetStartIndex<n>(),
+            ElementPack<Pre...>::template _GetStartIndex<m>());
+  }
+
+  template<int n, int m>
+  inline Eigen::Block<JacCurMat, ElementPack<Inn...>::template _GetStateDimension<n>(),
+         ElementPack<Cur...>::template _GetStateDimension<m>()> GetJacBlockCur(JacCurMat& J) const {
+    return J.template block<ElementPack<Inn...>::template _GetStateDimension<n>(),
+        ElementPack<Cur...>::template _GetStateDimension<m>()>(
+            ElementPack<Inn...>::template _GetStartIndex<n>(),
+            ElementPack<Cur...>::template _GetStartIndex<m>());
+  }
+
+  template<int n, int m>
+  inline Eigen::Block<JacNoiMat, ElementPack<Inn...>::template _GetStateDimension<n>(),
+         ElementPack<Noi...>::template _GetStateDimension<m>()> GetJacBlockNoi(JacNoiMat& J) const {
+    return J.template block<ElementPack<Inn...>::template _GetStateDimension<n>(),
+        ElementPack<Noi...>::template _GetStateDimension<m>()>(
+            ElementPack<Inn...>::template _GetStartIndex<n>(),
+            ElementPack<Noi...>::template _GetStartIndex<m>());
+  }
+
   bool TestJacs(const ElementVectorBase& pre,
                 const ElementVectorBase& cur,
                 const ElementVectorBase& noi,
@@ -288,8 +448,13 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
   friend mtBase;
   std::shared_ptr<const Meas> meas_;
   MatX R_;
+  bool isVectorSpaceMeas_;  // All measurement elements are vector spaces (exact run merging)
 
   // Wrapping from base (model) to user implementation
+  inline bool EvalJac(const std::array<MatX*, 3>& J, Inn&... inn,
+                      const Pre&... pre, const Cur&... cur, const Noi&... noi) const {
+    return EvalWithJacobians(*J[0], *J[1], *J[2], inn..., pre..., cur..., noi...);
+  }
   template<int j, typename std::enable_if<(j == 0)>::type* = nullptr>
   inline void Jac(MatX& J, const Pre&... pre, const Cur&... cur, const Noi&... noi) const {
     JacPre(J, pre..., cur..., noi...);
@@ -305,5 +470,52 @@ class BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,ElementPack<Cur...
 
 };
 
+/*! \brief Fixed-Size Jacobians
+ *         Adapter for residuals (Base is a BinaryResidual or derived from one) which implement their
+ *         Jacobians on stack-allocated fixed-size matrices. The dynamic Jacobians evaluate the
+ *         fixed-size ones and copy them into the type-erased matrices. All three fixed-size
+ *         Jacobians are pure virtual, such that a missing implementation fails to compile.
+ */
+template<typename Base, typename Residual = typename Base::mtBinaryRedidual>
+class FixedSizeJacobians;
+
+template<typename Base, typename ... Inn, typename ... Pre, typename ... Cur, typename ... Noi,
+    typename Meas>
+class FixedSizeJacobians<Base, BinaryResidual<ElementPack<Inn...>, ElementPack<Pre...>,
+                                              ElementPack<Cur...>, ElementPack<Noi...>, Meas>>
+    : public Base {
+ public:
+  typedef FixedSizeJacobians<Base> mtFixedSizeJacobians;
+  typedef typename Base::JacPreMat JacPreMat;
+  typedef typename Base::JacCurMat JacCurMat;
+  typedef typename Base::JacNoiMat JacNoiMat;
+  using Base::Base;
+  virtual ~FixedSizeJacobians() {
+  }
+
+  virtual void JacPre(JacPreMat& J, const Pre&... pre, const Cur&... cur,
+                      const Noi&... noi) const = 0;
+  virtual void JacCur(JacCurMat& J, const Pre&... pre, const Cur&... cur,
+                      const Noi&... noi) const = 0;
+  virtual void JacNoi(JacNoiMat& J, const Pre&... pre, const Cur&... cur,
+                      const Noi&... noi) const = 0;
+
+  void JacPre(MatX& J, const Pre&... pre, const Cur&... cur, const Noi&... noi) const {
+    JacPreMat JFixed;
+    JacPre(JFixed, pre..., cur..., noi...);
+    J = JFixed;
+  }
+  void JacCur(MatX& J, const Pre&... pre, const Cur&... cur, const Noi&... noi) const {
+    JacCurMat JFixed;
+    JacCur(JFixed, pre..., cur..., noi...);
+    J = JFixed;
+  }
+  void JacNoi(MatX& J, const Pre&... pre, const Cur&... cur, const Noi&... noi) const {
+    JacNoiMat JFixed;
+    JacNoi(JFixed, pre..., cur..., noi...);
+    J = JFixed;
+  }
+};
+
 }
 #endif /* GIF_BINARYRESIDUAL_HPP_ */
@@ -2,6 +2,7 @@
 #define GIF_COMMON_HPP_
 
 #include <array>
+#include <atomic>
 #include <Eigen/Dense>
 #include <iostream>
 #include <memory>
@@ -9,8 +10,35 @@
 #include <chrono>
 #include <glog/logging.h>
 
+/*! \brief Trace logging of the filter hot paths (per measurement and per update step). Levels above
+ *         GIF_TRACE_LEVEL are compiled out entirely, the remaining ones are only formatted if the
+ *         trace mode is enabled at runtime (GIF::SetTraceMode). 1: update summaries,
+ *         2: detailed timelines, innovations and measurement handling.
+ */
+#ifndef GIF_TRACE_LEVEL
+#ifdef NDEBUG
+#define GIF_TRACE_LEVEL 0
+#else
+#define GIF_TRACE_LEVEL 2
+#endif
+#endif
+#define GIF_TRACE_ON(level) ((level) <= GIF_TRACE_LEVEL && GIF::TraceMode())
+#define GIF_TRACE(level) LOG_IF(INFO, GIF_TRACE_ON(level))
+
 namespace GIF {
 
+// Read by the filter and the measurement producer threads, thus atomic (no ordering required)
+inline std::atomic<bool>& TraceModeFlag() {
+  static std::atomic<bool> enabled(false);
+  return enabled;
+}
+inline bool TraceMode() {
+  return TraceModeFlag().load(std::memory_order_relaxed);
+}
+inline void SetTraceMode(bool enabled) {
+  TraceModeFlag().store(enabled, std::memory_order_relaxed);
+}
+
 typedef kindr::RotationQuaternionPD Quat;
 typedef kindr::RotationMatrixPD RotMat;
 
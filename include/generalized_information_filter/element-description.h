@@ -14,39 +14,50 @@ class ElementDescriptionBase {
  public:
   typedef std::shared_ptr<ElementDescriptionBase> Ptr;
   typedef std::shared_ptr<const ElementDescriptionBase> CPtr;
-  ElementDescriptionBase() {}
+  ElementDescriptionBase(int typeId): typeId_(typeId) {}
   virtual ~ElementDescriptionBase() {}
 
-  virtual ElementBase::Ptr MakeElement(const CPtr& description) const = 0;
+  virtual ElementBase::Ptr MakeElement(const CPtr& description, void* data) const = 0;
   virtual bool MatchesDescription(const ElementDescriptionBase::CPtr& in) const = 0;
   virtual bool MatchesDescription(const ElementBase& in) const = 0;
   virtual int GetDim() const = 0;
   virtual bool IsVectorSpace() const = 0;
+  virtual int GetValueSize() const = 0;
+  virtual int GetValueAlignment() const = 0;
+  virtual bool IsPlain() const = 0;
+  virtual bool IsFlatVector() const = 0;
+  inline int GetTypeId() const {
+    return typeId_;
+  }
+
+ protected:
+  const int typeId_;  // Type id of the described element (see ElementTypeId)
 };
 
 /*! \brief Templated form of element descriptions.
  *         Implements the virtual methods of the base class (mainly based on
- *         dynamic casting).
+ *         the element type ids).
  */
 template<typename T>
 class ElementDescription : public ElementDescriptionBase {
  public:
   typedef std::shared_ptr<ElementDescription<T>> Ptr;
   typedef std::shared_ptr<const ElementDescription<T>> CPtr;
-  ElementDescription() {
+  ElementDescription(): ElementDescriptionBase(ElementTypeId<T>::Get()) {
   }
   ~ElementDescription() {
   }
-  ElementBase::Ptr MakeElement(const ElementDescriptionBase::CPtr& description) const {
+  ElementBase::Ptr MakeElement(const ElementDescriptionBase::CPtr& description,
+                               void* data) const {
+    LOG_IF(FATAL, description->GetTypeId() != typeId_) << "Element type mismatch";
     return std::make_shared<Element<T>>(
-        std::dynamic_pointer_cast<const ElementDescription<T>>(description));
+        std::static_pointer_cast<const ElementDescription<T>>(description), data);
   }
   bool MatchesDescription(const ElementDescriptionBase::CPtr& in) const {
-    return (bool)std::dynamic_pointer_cast<const ElementDescription<T>>(in);
+    return in && in->GetTypeId() == typeId_;
   }
   bool MatchesDescription(const ElementBase& in) const {
-    const ElementBase* inPtr = &in;
-    return dynamic_cast<const Element<T>*>(inPtr) != nullptr;
+    return in.GetTypeId() == typeId_;
   }
   inline int GetDim() const {
     return ElementTraits<T>::kDim;
@@ -54,6 +65,18 @@ class ElementDescription : public ElementDescriptionBase {
   inline bool IsVectorSpace() const {
     return ElementTraits<T>::kIsVectorSpace;
   }
+  inline int GetValueSize() const {
+    return sizeof(T);
+  }
+  inline int GetValueAlignment() const {
+    return alignof(T);
+  }
+  inline bool IsPlain() const {
+    return ElementIsPlain<T>::kValue;
+  }
+  inline bool IsFlatVector() const {
+    return ElementIsFlatVector<T>::kValue;
+  }
 };
 
 }
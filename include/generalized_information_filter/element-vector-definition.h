@@ -1,6 +1,7 @@
 #ifndef GIF_ELEMENTVECTORDEFINITION_HPP_
 #define GIF_ELEMENTVECTORDEFINITION_HPP_
 
+#include <mutex>
 #include <unordered_map>
 
 #include "generalized_information_filter/element-description.h"
@@ -10,16 +11,52 @@ namespace GIF {
 
 class ElementVectorBase;
 
+/*! \brief Symbol Table
+ *         Interns element names into integer symbol ids. Element vector
+ *         definitions store the symbol ids of their elements such that names
+ *         can be matched without string hashing or comparison. Both methods
+ *         lock the table; definitions cache the (stable) name pointers such
+ *         that name lookups on the hot path do not lock.
+ */
+class SymbolTable {
+ public:
+  static SymbolTable& Instance() {
+    static SymbolTable instance;
+    return instance;
+  }
+  int GetSymbol(const std::string& name);
+  const std::string& GetName(int symbol) const;
+
+ protected:
+  SymbolTable() {
+  }
+  std::unordered_map<std::string, int> symbols_map_;
+  std::vector<const std::string*> names_;  // Points into the keys of symbols_map_
+  mutable std::mutex mutex_;
+};
+
 /*! \brief Element Vector Definition
  *         Defines the structure of an element vector. The descriptions of the
  *         elements are stored as vector element_definions_. mames_map_ stores
  *         the identifiers (strings) of the elements and provides the map to
- *         the outer index.
+ *         the outer index. Additionally, the layout of the element values within
+ *         a contiguous buffer is computed (value_offsets_, in bytes). The
+ *         names are also interned as symbols (see SymbolTable) for fast
+ *         matching between definitions, symbol_outer_ maps the symbol ids to
+ *         the outer index by a dense table lookup.
  */
 class ElementVectorDefinition {
  public:
   typedef std::shared_ptr<ElementVectorDefinition> Ptr;
   typedef std::shared_ptr<const ElementVectorDefinition> CPtr;
+  /*! \brief Run of consecutive flat vector elements (value offset in bytes, start and dimension
+   *         in the tangent space). Used for batching boxplus/boxminus operations.
+   */
+  struct VectorRun {
+    int value_offset_;
+    int start_;
+    int dim_;
+  };
   ElementVectorDefinition();
   virtual ~ElementVectorDefinition();
   bool MatchesDefinition(const ElementVectorDefinition& other) const;
@@ -29,8 +66,16 @@ class ElementVectorDefinition {
   inline int GetStart(int outer_index) const;
   inline int GetOuter(int i) const;
   inline int GetInner(int i) const;
-  std::string GetName(int outer_index) const;
+  inline int GetValueOffset(int outer_index) const;
+  inline int GetValueSize() const;
+  inline bool IsPlain() const;
+  inline const std::vector<VectorRun>& GetVectorRuns() const;
+  inline const std::vector<int>& GetQuatIndices() const;
+  inline const std::vector<int>& GetOtherIndices() const;
+  const std::string& GetName(int outer_index) const;
   int FindName(const std::string& name) const;
+  inline int GetSymbol(int outer_index) const;
+  inline int FindSymbol(int symbol) const;
   const ElementDescriptionBase::CPtr& GetElementDescription(int outer_index) const;
   int AddElement(const std::string& name,
                  const ElementDescriptionBase::CPtr& new_element_definition);
@@ -41,8 +86,18 @@ class ElementVectorDefinition {
  protected:
   std::vector<ElementDescriptionBase::CPtr> descriptions_;
   std::vector<int> start_indices_;
+  std::vector<int> outer_indices_;  // Outer index for every scalar index
   std::unordered_map<std::string, int> names_map_;
+  std::vector<int> symbols_;  // Symbol id of every element
+  std::vector<const std::string*> names_;  // Interned name of every element (lock-free GetName)
+  std::vector<int> symbol_outer_;  // Outer index for every symbol id (-1 if not contained)
   int dim_;
+  std::vector<int> value_offsets_;
+  int value_size_;
+  bool is_plain_;
+  std::vector<VectorRun> vector_runs_;
+  std::vector<int> quat_indices_;
+  std::vector<int> other_indices_;
 };
 
 /*! \brief Template Helper class for computing the dimension of an ElementPack
@@ -96,17 +151,45 @@ int ElementVectorDefinition::GetStart(int outer_index) const {
 
 int ElementVectorDefinition::GetOuter(int i) const {
   DLOG_IF(FATAL, i < 0 | i >= GetDim()) << "Index out of range";
-  int outer_index = GetNumElements()-1;
-  while (GetStart(outer_index) > i) {
-    --outer_index;
-  }
-  return outer_index;
+  return outer_indices_[i];
 }
 
 int ElementVectorDefinition::GetInner(int i) const {
   return i - GetStart(GetOuter(i));
 }
 
+int ElementVectorDefinition::GetSymbol(int outer_index) const {
+  return symbols_.at(outer_index);
+}
+
+int ElementVectorDefinition::FindSymbol(int symbol) const {
+  return (symbol < symbol_outer_.size()) ? symbol_outer_[symbol] : -1;
+}
+
+int ElementVectorDefinition::GetValueOffset(int outer_index) const {
+  return value_offsets_.at(outer_index);
+}
+
+int ElementVectorDefinition::GetValueSize() const {
+  return value_size_;
+}
+
+bool ElementVectorDefinition::IsPlain() const {
+  return is_plain_;
+}
+
+const std::vector<ElementVectorDefinition::VectorRun>& ElementVectorDefinition::GetVectorRuns() const {
+  return vector_runs_;
+}
+
+const std::vector<int>& ElementVectorDefinition::GetQuatIndices() const {
+  return quat_indices_;
+}
+
+const std::vector<int>& ElementVectorDefinition::GetOtherIndices() const {
+  return other_indices_;
+}
+
 template<typename T>
 int ElementVectorDefinition::AddElement(const std::string& name) {
   AddElement(name, std::make_shared<ElementDescription<T>>());
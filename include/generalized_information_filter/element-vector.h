@@ -35,7 +35,7 @@ class ElementVectorBase {
   inline int GetStart(int outer_index) const;
   inline int GetOuter(int i) const;
   inline int GetInner(int i) const;
-  inline std::string GetName(int outer_index) const;
+  inline const std::string& GetName(int outer_index) const;
   inline int FindName(const std::string& name) const;
   std::string Print() const;
   void SetIdentity();
@@ -43,17 +43,24 @@ class ElementVectorBase {
   void BoxPlus(const VecCRefX& vec, ElementVectorBase* out) const;
   void BoxMinus(const ElementVectorBase& ref, VecRefX vec) const;
   const ElementVectorDefinition* GetDefinition() const;
+  virtual char* GetData();
+  virtual const char* GetData() const;
 
  protected:
+  static constexpr int kQuatBatch = 4;  // Number of quaternions processed together in BoxPlus
+
   const ElementVectorDefinition::CPtr def_;
 };
 
 /*! \brief Element Vector
- *         Holds the data as vector of element bases.
+ *         Holds the data as vector of element bases. The values of the elements
+ *         are stored in a single contiguous buffer (layout given by the
+ *         definition), such that plain element vectors can be copied at once.
  */
 class ElementVector : public ElementVectorBase {
  public:
   ElementVector(const ElementVectorDefinition::CPtr& def);
+  ElementVector(const ElementVector& other);
   virtual ~ElementVector();
   ElementVector& operator=(const ElementVectorBase& other);
   ElementVector& operator=(const ElementVector& other);
@@ -62,8 +69,11 @@ class ElementVector : public ElementVectorBase {
   inline ElementBase* GetElement(int i);
   inline const ElementBase* GetElement(int i) const;
   void Construct();
+  char* GetData();
+  const char* GetData() const;
 
  protected:
+  std::vector<char, Eigen::aligned_allocator<char>> data_;  // Must outlive elements_
   std::vector<ElementBase::Ptr> elements_;
 };
 
@@ -91,6 +101,16 @@ class ElementVectorWrapper : public ElementVectorBase {
   mutable const ElementVectorBase* const_element_vector_;
   const ElementVectorDefinition::CPtr inDef_;
   std::vector<int> indexMap_;
+
+  /*! \brief Contiguous run of columns (source column in the wrapper, destination column in the
+   *         wrapped element vector, width). Adjacent elements are merged into a single run.
+   */
+  struct ScatterRun {
+    int src_;
+    int dst_;
+    int width_;
+  };
+  std::vector<ScatterRun> scatterPlan_;
 };
 
 // ==================== Implementation ==================== //
@@ -134,7 +154,7 @@ int ElementVectorBase::GetInner(int i) const {
   return GetDefinition()->GetInner(i);
 }
 
-std::string ElementVectorBase::GetName(int outer_index) const {
+const std::string& ElementVectorBase::GetName(int outer_index) const {
   return GetDefinition()->GetName(outer_index);
 }
 
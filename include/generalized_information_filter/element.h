@@ -1,6 +1,8 @@
 #ifndef GIF_ELEMENT_HPP_
 #define GIF_ELEMENT_HPP_
 
+#include <atomic>
+
 #include "generalized_information_filter/common.h"
 
 namespace GIF {
@@ -10,6 +12,65 @@ class Element;
 template<typename T>
 class ElementDescription;
 
+/*! \brief Element type ids.
+ *         Unique integer tag per element type, replaces dynamic casting by a tag comparison and a
+ *         static cast. The ids are assigned on first use.
+ */
+inline int NewElementTypeId() {
+  static std::atomic<int> counter(0);
+  return counter++;
+}
+
+template<typename T>
+struct ElementTypeId {
+  static int Get() {
+    static const int id = NewElementTypeId();
+    return id;
+  }
+};
+
+/*! \brief Plain element types.
+ *         Element types whose values can be copied bytewise, allows element vectors to copy their
+ *         whole value buffer at once.
+ */
+template<typename T>
+struct ElementIsPlain {
+  static constexpr bool kValue = std::is_trivially_copyable<T>::value;
+};
+template<int N>
+struct ElementIsPlain<Vec<N>> {
+  static constexpr bool kValue = true;
+};
+template<>
+struct ElementIsPlain<Quat> {
+  static constexpr bool kValue = true;
+};
+template<typename T, size_t N>
+struct ElementIsPlain<std::array<T, N>> {
+  static constexpr bool kValue = ElementIsPlain<T>::kValue;
+};
+
+/*! \brief Flat vector element types.
+ *         Vector space elements whose value is stored as kDim consecutive doubles, i.e., the value
+ *         layout matches the layout of the tangent space vector.
+ */
+template<typename T>
+struct ElementIsFlatVector {
+  static constexpr bool kValue = false;
+};
+template<>
+struct ElementIsFlatVector<double> {
+  static constexpr bool kValue = true;
+};
+template<int N>
+struct ElementIsFlatVector<Vec<N>> {
+  static constexpr bool kValue = true;
+};
+template<typename T, size_t N>
+struct ElementIsFlatVector<std::array<T, N>> {
+  static constexpr bool kValue = ElementIsFlatVector<T>::kValue;
+};
+
 /*! \brief Element traits.
  *         Default implementation for zero dimension elements,
  *         may hold data which is not actively estimated/optimized.
@@ -55,7 +116,7 @@ class ElementBase {
  public:
   typedef std::shared_ptr<ElementBase> Ptr;
   typedef std::shared_ptr<const ElementBase> CPtr;
-  ElementBase() {
+  ElementBase(int typeId): typeId_(typeId) {
   }
   virtual ~ElementBase() {
   }
@@ -70,18 +131,24 @@ class ElementBase {
   virtual MatX BoxplusJacVec(const VecCRefX& vec) const = 0;
   virtual MatX BoxminusJacInp(const ElementBase& ref) const = 0;
   virtual MatX BoxminusJacRef(const ElementBase& ref) const = 0;
+  virtual void BoxminusJacInp(const ElementBase& ref, MatRefX out) const = 0;  // Preallocated out
+  inline int GetTypeId() const {
+    return typeId_;
+  }
+  // Typed access (hot path), the type tag is only checked in debug builds
   template<typename T>
   T& GetValue() {
-    Element<T>* const element =  dynamic_cast<Element<T>*>(this);
-    DLOG_IF(FATAL, element == nullptr) << "Dereferencing nullptr";
-    return element->GetValue();
+    DLOG_IF(FATAL, typeId_ != ElementTypeId<T>::Get()) << "Element type mismatch";
+    return static_cast<Element<T>*>(this)->GetValue();
   }
   template<typename T>
   const T& GetValue() const {
-    const Element<T>* const element =  dynamic_cast<const Element<T>*>(this);
-    DLOG_IF(FATAL, element == nullptr) << "Dereferencing nullptr";
-    return element->GetValue();
+    DLOG_IF(FATAL, typeId_ != ElementTypeId<T>::Get()) << "Element type mismatch";
+    return static_cast<const Element<T>*>(this)->GetValue();
   }
+
+ protected:
+  const int typeId_;
 };
 
 /*! \brief Templated form of Element.
@@ -92,20 +159,26 @@ template<typename T>
 class Element : public ElementBase {
  public:
   typedef ElementTraits<T> Traits;
-  Element(const typename ElementDescription<T>::CPtr description)
-      : description_(description) {
+  Element(const typename ElementDescription<T>::CPtr description, void* data)
+      : ElementBase(ElementTypeId<T>::Get()), description_(description) {
     DLOG_IF(FATAL, description == nullptr) << "Passing nullptr";
+    DLOG_IF(FATAL, data == nullptr) << "Passing nullptr";
+    x_ = new (data) T;
   }
+  // Owns the value constructed in place, copying or moving would share (and double destruct) it
+  Element(const Element<T>& other) = delete;
+  Element(Element<T>&& other) = delete;
+  Element<T>& operator=(Element<T>&& other) = delete;
   virtual ~Element() {
+    x_->~T();
   }
   virtual Element<T>& operator=(const Element<T>& other) {
     GetValue() = other.GetValue();
     return *this;
   }
   virtual ElementBase& operator=(const ElementBase& other) {
-    const Element<T>* const element =  dynamic_cast<const Element<T>*>(&other);
-    DLOG_IF(FATAL, element == nullptr) << "Dereferencing nullptr";
-    *this = *element;
+    LOG_IF(FATAL, other.GetTypeId() != typeId_) << "Element type mismatch";
+    *this = static_cast<const Element<T>&>(other);
     return *this;
   }
   inline virtual int GetDim() const {
@@ -138,14 +211,17 @@ class Element : public ElementBase {
   virtual MatX BoxminusJacRef(const ElementBase& ref) const {
     return Traits::BoxminusJacRef(GetValue(), ref.GetValue<T>());
   }
+  virtual void BoxminusJacInp(const ElementBase& ref, MatRefX out) const {
+    out = Traits::BoxminusJacInp(GetValue(), ref.GetValue<T>());
+  }
   T& GetValue() {
-    return x_;
+    return *x_;
   }
   const T& GetValue() const {
-    return x_;
+    return *x_;
   }
  protected:
-  T x_;
+  T* x_;  // Constructed in place, storage is owned by the element vector
   const typename ElementDescription<T>::CPtr description_;
 };
 
@@ -351,6 +427,18 @@ class ElementTraits<Quat> {
   static void Boxminus(const Quat& in, const Quat& ref, VecRef<kDim> vec) {
     vec = in.boxMinus(ref);
   }
+  /*! \brief Exponential map of N rotation vectors at once (columns of vec), the coefficients of
+   *         the resulting quaternions are written to the columns of q (w, x, y, z).
+   */
+  template<int N>
+  static void ExponentialMap(const Eigen::Array<double, 3, N>& vec,
+                             Eigen::Array<double, 4, N>& q) {
+    const Eigen::Array<double, 1, N> angle = vec.matrix().colwise().norm().array();
+    const Eigen::Array<double, 1, N> scale = (angle < 1e-8).select(
+        0.5 - angle.square() / 48.0, (0.5 * angle).sin() / angle);
+    q.row(0) = (0.5 * angle).cos();
+    q.template bottomRows<3>() = vec.rowwise() * scale;
+  }
   static Mat<kDim> BoxplusJacInp(const Quat& in, const VecCRef<kDim>& vec) {
     RotMat m = m.exponentialMap(vec);
     return m.matrix();
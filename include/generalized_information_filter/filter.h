@@ -1,6 +1,8 @@
 #ifndef GIF_FILTER_HPP_
 #define GIF_FILTER_HPP_
 
+#include <algorithm>
+
 #include "generalized_information_filter/common.h"
 #include "generalized_information_filter/binary-residual.h"
 #include "generalized_information_filter/measurement.h"
@@ -15,8 +17,10 @@ struct ResidualStruct {
                  const ElementVectorDefinition::Ptr& stateDefinition,
                  const ElementVectorDefinition::Ptr& noiseDefinition,
                  const Duration& maxWaitTime,
-                 const Duration& minWaitTime):
+                 const Duration& minWaitTime,
+                 int queueCapacity):
                      mt_(!res->isUnary_, maxWaitTime, minWaitTime),
+                     queue_(new MeasurementQueue(queueCapacity)),
                      preWrap_(res->PreDefinition(), stateDefinition),
                      curWrap_(res->CurDefinition(), stateDefinition),
                      noiWrap_(res->NoiDefinition(), noiseDefinition),
@@ -34,13 +38,27 @@ struct ResidualStruct {
     jacPre_.resize(innDim_, res->PreDefinition()->GetDim());
     jacCur_.resize(innDim_, res->CurDefinition()->GetDim());
     jacNoi_.resize(innDim_, res->NoiDefinition()->GetDim());
+    jacNoiR_.resize(innDim_, res->NoiDefinition()->GetDim());
+    WinvJacPre_.resize(innDim_, res->PreDefinition()->GetDim());
+    JacPreWinvJacPre_.resize(res->PreDefinition()->GetDim(), res->PreDefinition()->GetDim());
+    W_.resize(innDim_, innDim_);
+    W_LDLT_ = Eigen::LDLT<MatX>(innDim_);
+    W_LLT_ = Eigen::LLT<MatX>(innDim_);
     isActive_ = false;
+    useEvalWithJacobians_ = true;
+    for (int i = 0; i < res->PreDefinition()->GetNumElements(); i++) {
+      preOuter_.push_back(stateDefinition->FindSymbol(res->PreDefinition()->GetSymbol(i)));
+    }
+    for (int i = 0; i < res->CurDefinition()->GetNumElements(); i++) {
+      curOuter_.push_back(stateDefinition->FindSymbol(res->CurDefinition()->GetSymbol(i)));
+    }
   }
   ~ResidualStruct() {
   }
 
   BinaryResidualBase::Ptr res_;
   MeasurementTimeline mt_;
+  std::shared_ptr<MeasurementQueue> queue_;  // Measurements pushed from other threads
   ElementVectorWrapper preWrap_;
   ElementVectorWrapper curWrap_;
   ElementVectorWrapper noiWrap_;
@@ -49,8 +67,113 @@ struct ResidualStruct {
   MatX jacPre_;
   MatX jacCur_;
   MatX jacNoi_;
+  MatX jacNoiR_;  // Noise Jacobian multiplied with the (weighted) noise covariance
+  MatX WinvJacPre_;        // Only used if the noise is not shared
+  MatX JacPreWinvJacPre_;  // Only used if the noise is not shared
+  MatX W_;        // Innovation weighting block (only used if the noise is not shared)
+  Eigen::LDLT<MatX> W_LDLT_;
+  Eigen::LLT<MatX> W_LLT_;  // Whitening of the innovation (only used by the square-root solver)
   int innDim_;
   bool isActive_;
+  bool useEvalWithJacobians_;  // Cleared once the residual reports no fused implementation
+  std::vector<int> preOuter_;  // Outer indices of previous state elements in filter state
+  std::vector<int> curOuter_;  // Outer indices of current state elements in filter state
+};
+
+/*! \brief Update Workspace
+ *         Preallocated temporaries of the update step. Sized once for the full state/noise and the
+ *         maximal stacked innovation dimension, each update step only works on the leading blocks.
+ *         There is a single factorization per role. The factorizations are not in place, they
+ *         reallocate whenever the dimension of their block changes. These dimensions depend on the
+ *         connected state blocks (thus on the set of active residuals), such that update steps are
+ *         only allocation-free as long as the same residuals stay active.
+ */
+struct UpdateWorkspace {
+  UpdateWorkspace(const ElementVectorDefinition::Ptr& stateDefinition):
+      newState_(stateDefinition) {
+  }
+
+  void Resize(int stateDim, int noiseDim, int maxInnDim) {
+    y_.resize(maxInnDim);
+    jacPre_.resize(maxInnDim, stateDim);
+    jacCur_.resize(maxInnDim, stateDim);
+    jacNoi_.resize(maxInnDim, noiseDim);
+    jacNoiR_.resize(maxInnDim, noiseDim);
+    W_.resize(maxInnDim, maxInnDim);
+    Winv_.resize(maxInnDim, maxInnDim);
+    WinvJacPre_.resize(maxInnDim, stateDim);
+    WinvJacCur_.resize(maxInnDim, stateDim);
+    Winvy_.resize(maxInnDim);
+    WinvJacPreDinv_.resize(maxInnDim, stateDim);
+    M_.resize(maxInnDim, maxInnDim);
+    S_.resize(stateDim, maxInnDim);
+    D_.resize(stateDim, stateDim);
+    JacPreWinvJacPre_.resize(stateDim, stateDim);
+    DinvPre_.resize(stateDim, stateDim);
+    infUU_.resize(stateDim, stateDim);
+    infUP_.resize(stateDim, stateDim);
+    infUUinvUP_.resize(stateDim, stateDim);
+    infInvP_.resize(stateDim, stateDim);
+    X_.resize(stateDim, stateDim + 1);
+    JacCurWinvJacPre_.resize(stateDim, stateDim);
+    newInfCur_.resize(stateDim, stateDim);
+    newInf_.resize(stateDim, stateDim);
+    sqrtA_.resize(maxInnDim, 2 * stateDim + 1);
+    householder_.resize(2 * stateDim + 1);
+    newSqrtInfCur_.resize(stateDim, stateDim);
+    newSqrtInf_.resize(stateDim, stateDim);
+    zCur_.resize(stateDim);
+    Sy_.resize(stateDim);
+    dxCur_.resize(stateDim);
+    infDx_.resize(stateDim);
+    dx_.resize(stateDim);
+    innJac_.resize(maxInnDim, maxInnDim);
+    innJacPre_.resize(maxInnDim, stateDim);
+    newState_.Construct();
+  }
+
+  VecX y_;
+  MatX jacPre_;
+  MatX jacCur_;
+  MatX jacNoi_;
+  MatX jacNoiR_;
+  MatX W_;
+  MatX Winv_;
+  MatX WinvJacPre_;
+  MatX WinvJacCur_;
+  VecX Winvy_;
+  MatX WinvJacPreDinv_;
+  MatX M_;
+  MatX S_;
+  MatX D_;
+  MatX JacPreWinvJacPre_;
+  MatX DinvPre_;
+  MatX infUU_;
+  MatX infUP_;
+  MatX infUUinvUP_;
+  MatX infInvP_;        // Columns of inv(inf) of the connected previous blocks
+  MatX X_;
+  MatX JacCurWinvJacPre_;
+  MatX newInfCur_;
+  MatX newInf_;
+  MatX sqrtA_;          // Whitened stacked system [Jpre, Jcur, y] of the square-root solver
+  VecX householder_;
+  MatX newSqrtInfCur_;
+  MatX newSqrtInf_;
+  VecX zCur_;
+  VecX Sy_;
+  VecX dxCur_;
+  VecX infDx_;
+  VecX dx_;
+  MatX innJac_;         // Boxminus Jacobian of a non vector space innovation element
+  MatX innJacPre_;      // Corresponding product with the previous state Jacobian
+  Eigen::LDLT<MatX> D_LDLT_;
+  Eigen::LDLT<MatX> U_LDLT_;  // Unconnected previous information (Schur complement)
+  Eigen::LDLT<MatX> P_LDLT_;  // Connected previous covariance (marginalization through inf_LDLT_)
+  Eigen::LDLT<MatX> W_LDLT_;
+  Eigen::LDLT<MatX> I_LDLT_;
+  Eigen::LLT<MatX> W_LLT_;
+  ElementVector newState_;
 };
 
 /*! \brief Filter
@@ -59,14 +182,44 @@ struct ResidualStruct {
  */
 class Filter {
  public:
+  /*! \brief Linear algebra used for the update step. SOLVER_INVERSE forms the explicit inverses of
+   *         W and D, SOLVER_FACTORIZED only solves with their LDLT factorizations (better
+   *         conditioned and cheaper for large states). SOLVER_SQUARE_ROOT keeps an upper triangular
+   *         factor of the information matrix and updates it by Householder QR on the whitened
+   *         stacked Jacobians (square-root information filter).
+   */
+  enum UpdateSolver {
+    SOLVER_INVERSE,
+    SOLVER_FACTORIZED,
+    SOLVER_SQUARE_ROOT
+  };
+
+  /*! \brief Default ratio of unconnected to connected previous dimension (u/p) above which the
+   *         unconnected previous blocks are marginalized through the available factorization of
+   *         inf instead of the Schur complement (see ComputeD). Solving for the p covariance
+   *         columns and inverting them costs about (u+p)^2*p + 4/3*p^3 flops, factorizing inf_UU
+   *         and forming the Schur complement about u^3/3 + u^2*p + u*p^2. The former is cheaper
+   *         for u^3 > 3*u*p^2 + 7*p^3, i.e., from about u = 2.5*p on, 3 leaves a margin for the
+   *         gathering overhead.
+   */
+  static constexpr double kMarginalizationRatio = 3.0;
+
   Filter(): stateDefinition_(new ElementVectorDefinition()),
             state_(stateDefinition_), curLinState_(stateDefinition_),
             noiseDefinition_(new ElementVectorDefinition()),
-            noise_(noiseDefinition_){
+            noise_(noiseDefinition_), ws_(stateDefinition_){
     is_initialized_ = false;
+    sharedNoise_ = false;
     include_max_ = false;
     num_iter_ = 1;
     iter_th_ = 0.0;
+    solver_ = SOLVER_INVERSE;
+    marginalizationRatio_ = kMarginalizationRatio;
+    infIsCurrent_ = true;
+    sqrtInfIsCurrent_ = false;
+    infVersion_ = 1;
+    infLDLTVersion_ = 0;
+    lastMeasTime_ = TimePoint::min();
   }
 
   virtual ~Filter() {
@@ -82,6 +235,9 @@ class Filter {
       state_.SetIdentity();
     }
     inf_.setIdentity();
+    infIsCurrent_ = true;
+    sqrtInfIsCurrent_ = false;
+    infVersion_++;
     is_initialized_ = true;
   }
 
@@ -92,12 +248,29 @@ class Filter {
     noise_.Construct();
     noise_.SetIdentity();
     inf_.resize(stateDefinition_->GetDim(), stateDefinition_->GetDim());
+    sqrtInf_.resize(stateDefinition_->GetDim(), stateDefinition_->GetDim());
+    infIsCurrent_ = true;
+    sqrtInfIsCurrent_ = false;
+    infVersion_++;
+    int maxInnDim = 0;
+    for (int i = 0; i < residuals_.size(); i++) {
+      maxInnDim += residuals_.at(i).innDim_;
+    }
+    ws_.Resize(stateDefinition_->GetDim(), noiseDefinition_->GetDim(), maxInnDim);
   }
 
   int AddResidual(const BinaryResidualBase::Ptr& res,
                   const Duration& maxWaitTime,
-                  const Duration& minWaitTime) {
-    residuals_.emplace_back(res, stateDefinition_, noiseDefinition_, maxWaitTime, minWaitTime);
+                  const Duration& minWaitTime,
+                  int queueCapacity = 1024) {
+    // If residuals share noise elements, W is no longer block-diagonal over the residuals
+    for (int i = 0; i < res->NoiDefinition()->GetNumElements(); i++) {
+      if (noiseDefinition_->FindSymbol(res->NoiDefinition()->GetSymbol(i)) != -1) {
+        sharedNoise_ = true;
+      }
+    }
+    residuals_.emplace_back(res, stateDefinition_, noiseDefinition_, maxWaitTime, minWaitTime,
+                            queueCapacity);
     Construct();
     return residuals_.size() - 1;
   }
@@ -110,12 +283,9 @@ class Filter {
     return noiseDefinition_;
   }
 
+  // Latest time among all measurement timelines (maintained by AddMeasurement)
   TimePoint GetCurrentTimeFromMeasurements() const {
-    TimePoint currentTime = TimePoint::min();
-    for (int i = 0; i < residuals_.size(); i++) {
-      currentTime = std::max(currentTime, residuals_.at(i).mt_.GetLastTime());
-    }
-    return currentTime;
+    return lastMeasTime_;
   }
 
   TimePoint GetMaxUpdateTime(const TimePoint& currentTime) const {
@@ -139,24 +309,34 @@ class Filter {
     return check ? maxMinMeasTime : TimePoint::min();
   }
 
-  void GetMeasurementTimeList(std::set<TimePoint>& times,
+  // Computes the strictly increasing list of update times up to maxUpdateTime
+  void GetMeasurementTimeList(std::vector<TimePoint>& times,
                               const TimePoint& maxUpdateTime,
-                              const bool includeMax) const {
+                              const bool includeMax) {
+    // Add all non-mergeable measurement times, events up to the state time have been processed or
+    // removed as outdated
+    times.clear();
+    while (!updateEvents_.Empty() && updateEvents_.Front().t_ <= time_) {
+      updateEvents_.PopFront();
+    }
+    for (int k = 0; k < updateEvents_.Size() && updateEvents_.At(k).t_ <= maxUpdateTime; k++) {
+      times.push_back(updateEvents_.At(k).t_);
+    }
     for (int i = 0; i < residuals_.size(); i++) {
-      if (!residuals_.at(i).res_->isMergeable_) {
-        // Add all non-mergeable measurement times
-        residuals_.at(i).mt_.GetAllInRange(times, time_, maxUpdateTime);
-      } else if (!residuals_.at(i).res_->isSplitable_ && residuals_.at(i).res_->isUnary_) {
+      if (residuals_.at(i).res_->isMergeable_ && !residuals_.at(i).res_->isSplitable_
+          && residuals_.at(i).res_->isUnary_) {
         // For the special case of unary and mergeable residuals add the last measurement time
         residuals_.at(i).mt_.GetLastInRange(times, time_, maxUpdateTime);
       }
     }
     if (includeMax && maxUpdateTime > time_) {
-      times.insert(maxUpdateTime);
+      times.push_back(maxUpdateTime);
     }
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
   }
 
-  void SplitAndMergeMeasurements(const std::set<TimePoint>& times) {
+  void SplitAndMergeMeasurements(const std::vector<TimePoint>& times) {
     for (int i = 0; i < residuals_.size(); i++) {
       if (residuals_.at(i).res_->isSplitable_ && !residuals_.at(i).res_->isUnary_) {
         // First insert all (splitable + !unary)
@@ -175,14 +355,47 @@ class Filter {
       LOG(WARNING) << "Adding measurements before current time (will be discarded)" << std::endl;
       return;
     }
-    LOG(INFO) << "Adding measurement with ID " << i << " at  t = " << Print(t) << std::endl;
+    GIF_TRACE(2) << "Adding measurement with ID " << i << " at  t = " << Print(t) << std::endl;
     if(residuals_.at(i).res_->CheckMeasType(meas)){
-      residuals_.at(i).mt_.AddMeasurement(meas, t);
+      lastMeasTime_ = std::max(lastMeasTime_, t);
+      if (residuals_.at(i).mt_.AddMeasurement(meas, t) && !residuals_.at(i).res_->isMergeable_) {
+        if (updateEvents_.Empty() || updateEvents_.Back().t_ < t) {
+          updateEvents_.PushBack(t, nullptr);
+        } else if (updateEvents_.Find(t) == -1) {
+          updateEvents_.Insert(updateEvents_.LowerBound(t), t, nullptr);
+        }
+      }
     } else {
       LOG(ERROR) << "Passing wrong measurement type";
     }
   }
 
+  /*! \brief Thread-safe alternative to AddMeasurement, the measurement is only queued and added to
+   *         the timeline during the next Update(). At most one thread may push per residual, and all
+   *         residuals must be added beforehand. Returns false if the queue is full.
+   */
+  bool PushMeasurement(const int i, const ElementVectorBase::CPtr& meas,
+                       const TimePoint& t) {
+    if (!residuals_.at(i).queue_->Push(meas, t)) {
+      LOG(WARNING) << "Measurement queue of " << residuals_.at(i).res_->name_
+                   << " is full (measurement discarded)";
+      return false;
+    }
+    return true;
+  }
+
+  // Moves all pushed measurements into the timelines (called by Update)
+  void DrainMeasurementQueues() {
+    ElementVectorBase::CPtr meas;
+    TimePoint t;
+    for (int i = 0; i < residuals_.size(); i++) {
+      while (residuals_.at(i).queue_->Pop(meas, t)) {
+        AddMeasurement(i, meas, t);
+      }
+    }
+    meas.reset();
+  }
+
   void PrintMeasurementTimelines(const TimePoint& start, int startOffset, double resolution) {
     std::ostringstream out;
     for (int i = 0; i < startOffset; i++) {
@@ -196,6 +409,8 @@ class Filter {
   }
 
   void Update() {
+    DrainMeasurementQueues();
+
     // Initialize if possible
     if(!is_initialized_ && GetMaxMinMeasTime() != TimePoint::min()){
       Init(GetMaxMinMeasTime());
@@ -210,25 +425,30 @@ class Filter {
           LOG(ERROR) << "Last processed time is in future, this should not happen!" << std::endl;
         }
       }
-      PrintMeasurementTimelines(time_, 20, 0.001);
-      LOG(INFO) << "stateTime:\t" << Print(time_);
+      if (GIF_TRACE_ON(2)) {
+        PrintMeasurementTimelines(time_, 20, 0.001);
+      }
+      GIF_TRACE(1) << "stateTime:\t" << Print(time_);
       TimePoint currentTime = GetCurrentTimeFromMeasurements();
-      LOG(INFO) << "currentTime:\t" << Print(currentTime);
+      GIF_TRACE(1) << "currentTime:\t" << Print(currentTime);
       TimePoint maxUpdateTime = GetMaxUpdateTime(currentTime);
-      LOG(INFO) << "maxUpdateTime:\t" << Print(maxUpdateTime);
-      std::set<TimePoint> times;
-      GetMeasurementTimeList(times, maxUpdateTime, include_max_);
-      std::ostringstream out;
-      out << "updateTimes:\t";
-      for (const auto& t : times) {
-        out << Print(t) << "\t";
-      }
-      LOG(INFO) << out.str();
-      SplitAndMergeMeasurements(times);
-      PrintMeasurementTimelines(time_, 20, 0.001);
+      GIF_TRACE(1) << "maxUpdateTime:\t" << Print(maxUpdateTime);
+      GetMeasurementTimeList(updateTimes_, maxUpdateTime, include_max_);
+      if (GIF_TRACE_ON(1)) {
+        std::ostringstream out;
+        out << "updateTimes:\t";
+        for (const auto& t : updateTimes_) {
+          out << Print(t) << "\t";
+        }
+        LOG(INFO) << out.str();
+      }
+      SplitAndMergeMeasurements(updateTimes_);
+      if (GIF_TRACE_ON(2)) {
+        PrintMeasurementTimelines(time_, 20, 0.001);
+      }
 
       // Carry out updates
-      for (const auto& t : times) {
+      for (const auto& t : updateTimes_) {
         MakeUpdateStep(t);
       }
     }
@@ -251,20 +471,23 @@ class Filter {
     }
     PreProcess();
 
-    // Temporaries
-    VecX y(innDim);
-    y.setZero();
-    MatX JacPre(innDim, stateDefinition_->GetDim());
-    JacPre.setZero();
-    MatX JacCur(innDim, stateDefinition_->GetDim());
-    JacCur.setZero();
-    MatX JacNoi(innDim, noiseDefinition_->GetDim());
-    JacNoi.setZero();
-    MatX R(noiseDefinition_->GetDim(), noiseDefinition_->GetDim());
-    R.setIdentity();
-    MatX Winv(innDim, innDim);
-    Winv.setZero();
-    MatX newInf(stateDefinition_->GetDim(),stateDefinition_->GetDim());
+    // Connected state blocks (only these are touched by the Jacobians)
+    const int preDim = ComputeConnectedBlocks(preBlockStart_, true);
+    const int curDim = ComputeConnectedBlocks(curBlockStart_, false);
+
+    // Workspace blocks of the current dimensions
+    const int stateDim = stateDefinition_->GetDim();
+    UpdateWorkspace& ws = ws_;
+    auto y = ws.y_.head(innDim);
+    auto JacPre = ws.jacPre_.topLeftCorner(innDim, preDim);
+    auto JacCur = ws.jacCur_.topLeftCorner(innDim, curDim);
+    auto JacNoi = ws.jacNoi_.topRows(innDim);
+    auto JacNoiR = ws.jacNoiR_.topRows(innDim);
+    if (solver_ == SOLVER_SQUARE_ROOT) {
+      SyncSqrtInformation();
+    } else {
+      SyncInformation();
+    }
 
     double weightedUpdate = iter_th_;
     for(int step=0;step<num_iter_ && weightedUpdate >= iter_th_;step++){
@@ -272,9 +495,10 @@ class Filter {
       y.setZero();
       JacPre.setZero();
       JacCur.setZero();
-      JacNoi.setZero();
-      R.setIdentity();
-      Winv.setZero();
+      if (sharedNoise_) {
+        JacNoi.setZero();
+        JacNoiR.setZero();
+      }
 
       // Evaluate residuals and Jacobians
       int count = 0;
@@ -284,84 +508,147 @@ class Filter {
           rs.preWrap_.SetElementVector(&state_);
           rs.curWrap_.SetElementVector(&curLinState_);
           rs.noiWrap_.SetElementVector(&noise_);
-          rs.res_->Eval(&rs.inn_, rs.preWrap_,
-                                  rs.curWrap_,
-                                  rs.noiWrap_);
+          rs.res_->SetInputVersion(BinaryResidualBase::NewInputVersion());
+          // Prefer the fused evaluation, fall back to individual calls if not implemented
+          if (!rs.useEvalWithJacobians_ ||
+              !rs.res_->EvalWithJacobians(&rs.inn_, rs.jacPre_, rs.jacCur_, rs.jacNoi_,
+                                          rs.preWrap_, rs.curWrap_, rs.noiWrap_)) {
+            rs.useEvalWithJacobians_ = false;
+            rs.res_->Eval(&rs.inn_, rs.preWrap_,
+                                    rs.curWrap_,
+                                    rs.noiWrap_);
+            rs.res_->JacPre(rs.jacPre_, rs.preWrap_,
+                                        rs.curWrap_,
+                                        rs.noiWrap_);
+            rs.res_->JacCur(rs.jacCur_, rs.preWrap_,
+                                        rs.curWrap_,
+                                        rs.noiWrap_);
+            rs.res_->JacNoi(rs.jacNoi_, rs.preWrap_,
+                                        rs.curWrap_,
+                                        rs.noiWrap_);
+          }
+          rs.res_->SetInputVersion(0);
           rs.inn_.BoxMinus(rs.innRef_, y.block(count, 0, rs.innDim_, 1));
           LOG_IF(ERROR,y.hasNaN()) << "Residual " << rs.res_->name_
                                    << " contains NaN!\n" << y.transpose();
-          rs.res_->JacPre(rs.jacPre_, rs.preWrap_,
-                                      rs.curWrap_,
-                                      rs.noiWrap_);
           LOG_IF(ERROR,rs.jacPre_.hasNaN()) << "jacPre " << rs.res_->name_ << " contains NaN!";
-          rs.res_->JacCur(rs.jacCur_, rs.preWrap_,
-                                      rs.curWrap_,
-                                      rs.noiWrap_);
           LOG_IF(ERROR,rs.jacCur_.hasNaN()) << "jacCur " << rs.res_->name_ << " contains NaN!";
-          rs.res_->JacNoi(rs.jacNoi_, rs.preWrap_,
-                                      rs.curWrap_,
-                                      rs.noiWrap_);
           LOG_IF(ERROR,rs.jacNoi_.hasNaN()) << "jacNoi " << rs.res_->name_ << " contains NaN!";
           for(int j=0;j<rs.res_->InnDefinition()->GetNumElements();j++){
             const ElementDescriptionBase::CPtr& description =
                 rs.res_->InnDefinition()->GetElementDescription(j);
             if(!description->IsVectorSpace()){
-              rs.jacPre_.block(rs.res_->InnDefinition()->GetStart(j),0,
-                  description->GetDim(),rs.preWrap_.GetDim()) =
-                      rs.inn_.GetElement(j)->BoxminusJacInp(*rs.innRef_.GetElement(j)) *
-                      rs.jacPre_.block(rs.res_->InnDefinition()->GetStart(j),0,
-                                      description->GetDim(),rs.preWrap_.GetDim());
+              const int dim = description->GetDim();
+              auto innJac = ws.innJac_.topLeftCorner(dim, dim);
+              auto innJacPre = ws.innJacPre_.topLeftCorner(dim, rs.preWrap_.GetDim());
+              auto jacPre = rs.jacPre_.block(rs.res_->InnDefinition()->GetStart(j), 0,
+                                             dim, rs.preWrap_.GetDim());
+              rs.inn_.GetElement(j)->BoxminusJacInp(*rs.innRef_.GetElement(j), innJac);
+              innJacPre.noalias() = innJac * jacPre;
+              jacPre = innJacPre;
             }
           }
 
-          rs.preWrap_.EmbedJacobian(JacPre, rs.jacPre_, count);
-          rs.curWrap_.EmbedJacobian(JacCur, rs.jacCur_, count);
-          rs.noiWrap_.EmbedJacobian(JacNoi, rs.jacNoi_, count);
+          EmbedConnectedJacobian(JacPre, rs.jacPre_, *rs.res_->PreDefinition(), rs.preOuter_,
+                                 preBlockStart_, count);
+          EmbedConnectedJacobian(JacCur, rs.jacCur_, *rs.res_->CurDefinition(), rs.curOuter_,
+                                 curBlockStart_, count);
 
-          for(int j=0;j<rs.res_->NoiDefinition()->GetNumElements();j++){
-            const ElementDescriptionBase::CPtr& description =
-                rs.res_->NoiDefinition()->GetElementDescription(j);
-            const int noiDim = description->GetDim();
-            const int start1 = rs.res_->NoiDefinition()->GetStart(j);
-            const int start2 = NoiseDefinition()->GetStart(NoiseDefinition()->FindName(rs.res_->NoiDefinition()->GetName(j)));
-            const double weight = rs.res_->GetNoiseWeighting(rs.inn_,j);
-            R.block(start2,start2,noiDim,noiDim) = 1/pow(weight,2)*rs.res_->GetNoiseCovariance().block(start1,start1,noiDim,noiDim); // TODO: speed up and clean up
+          ComputeWeightedNoiseJacobian(rs);
+          if (sharedNoise_) {
+            rs.noiWrap_.EmbedJacobian(JacNoi, rs.jacNoi_, count);
+            rs.noiWrap_.EmbedJacobian(JacNoiR, rs.jacNoiR_, count);
+          } else {
+            rs.W_.noalias() = rs.jacNoiR_ * rs.jacNoi_.transpose();
           }
           count += rs.innDim_;
         }
       }
-      LOG(INFO) << "Innovation:\t" << y.transpose();
-//      std::cout << JacPre << std::endl;
-//      std::cout << JacCur << std::endl;
-//      std::cout << JacNoi << std::endl;
-//      std::cout << R << std::endl;
-//      std::cout << "Innovation:\t" << y.transpose() << std::endl;
-
-      // Compute weighting // TODO: make more efficient, exploit sparsity
-      Eigen::LDLT<MatX> W_LDLT(JacNoi*R*JacNoi.transpose());
-      LOG_IF(ERROR,W_LDLT.info() != Eigen::Success) << "Computation of Winv failed";
-      Winv = W_LDLT.solve(GIF::MatX::Identity(innDim,innDim));
-
-      // Compute Kalman Update
-      MatX D = inf_ + JacPre.transpose() * Winv * JacPre;
-      MatX S = JacCur.transpose() * (Winv - Winv * JacPre * D.inverse() * JacPre.transpose() * Winv);
-      newInf = S * JacCur;
-      Eigen::LDLT<MatX> I_LDLT(newInf);
-      LOG_IF(ERROR,I_LDLT.info() != Eigen::Success) << "Computation of Iinv failed";
-      VecX dx = -I_LDLT.solve(S * y);
+      GIF_TRACE(2) << "Innovation:\t" << y.transpose();
+
+      // Compute weighting, block-wise per residual if no noise is shared
+      if (sharedNoise_) {
+        auto W = ws.W_.topLeftCorner(innDim, innDim);
+        W.noalias() = JacNoiR * JacNoi.transpose();
+        if (solver_ == SOLVER_SQUARE_ROOT) {
+          ws.W_LLT_.compute(W);
+          LOG_IF(ERROR,ws.W_LLT_.info() != Eigen::Success) << "Cholesky factorization of W failed";
+        } else {
+          ws.W_LDLT_.compute(W);
+          LOG_IF(ERROR,ws.W_LDLT_.info() != Eigen::Success) << "Computation of Winv failed";
+        }
+      } else {
+        for (int i = 0; i < residuals_.size(); i++) {
+          if (residuals_.at(i).isActive_) {
+            ResidualStruct& rs = residuals_.at(i);
+            if (solver_ == SOLVER_SQUARE_ROOT) {
+              rs.W_LLT_.compute(rs.W_);
+              LOG_IF(ERROR,rs.W_LLT_.info() != Eigen::Success)
+                  << "Cholesky factorization of W failed for " << rs.res_->name_;
+            } else {
+              rs.W_LDLT_.compute(rs.W_);
+              LOG_IF(ERROR,rs.W_LDLT_.info() != Eigen::Success) << "Computation of Winv failed for "
+                                                                << rs.res_->name_;
+            }
+          }
+        }
+      }
+      // Compute Kalman Update, the Jacobians only span the connected blocks, thus the previous
+      // information is only modified on these and only the corresponding part of inv(D) is used.
+      auto dxCur = ws.dxCur_.head(curDim);
+      if (solver_ == SOLVER_SQUARE_ROOT) {
+        // The updated factor directly yields the increment by back substitution
+        ComputeSquareRootUpdate(innDim, preDim, curDim);
+        auto newSqrtInfCur = ws.newSqrtInfCur_.topLeftCorner(curDim, curDim);
+        ws.newSqrtInf_.setZero();
+        AddConnectedBlocks(ws.newSqrtInf_, newSqrtInfCur, curBlockStart_, curBlockStart_);
+        dxCur = -ws.zCur_.head(curDim);
+        newSqrtInfCur.triangularView<Eigen::Upper>().solveInPlace(dxCur);
+        ws.infDx_.head(curDim).noalias() = newSqrtInfCur.triangularView<Eigen::Upper>() * dxCur;
+        weightedUpdate = ws.infDx_.head(curDim).squaredNorm()/stateDim;
+      } else {
+        if (solver_ == SOLVER_INVERSE) {
+          ComputeInverseUpdate(innDim, preDim, curDim);
+        } else {
+          ComputeFactorizedUpdate(innDim, preDim, curDim);
+        }
+        auto newInfCur = ws.newInfCur_.topLeftCorner(curDim, curDim);
+        ws.newInf_.setZero();
+        AddConnectedBlocks(ws.newInf_, newInfCur, curBlockStart_, curBlockStart_);
+        ws.I_LDLT_.compute(newInfCur);
+        LOG_IF(ERROR,ws.I_LDLT_.info() != Eigen::Success) << "Computation of Iinv failed";
+        dxCur = ws.I_LDLT_.solve(ws.Sy_.head(curDim));
+        dxCur *= -1.0;
+        ws.infDx_.head(curDim).noalias() = newInfCur * dxCur;
+        weightedUpdate = dxCur.dot(ws.infDx_.head(curDim))/stateDim;
+      }
+      ws.dx_.setZero();
+      AddConnectedRows(ws.dx_, dxCur, curBlockStart_);
 
       // Apply Kalman Update
-      ElementVector newState(stateDefinition_);
-      curLinState_.BoxPlus(dx, &newState);
-      curLinState_ = newState;
-      weightedUpdate = (dx.transpose()*newInf*dx)(0)/dx.size();
+      curLinState_.BoxPlus(ws.dx_, &ws.newState_);
+      curLinState_ = ws.newState_;
     }
 
     state_ = curLinState_;
-    inf_ = newInf;
+    infVersion_++;
+    if (solver_ == SOLVER_SQUARE_ROOT) {
+      sqrtInf_ = ws_.newSqrtInf_;
+      infIsCurrent_ = false;
+    } else {
+      inf_ = ws_.newInf_;
+      sqrtInfIsCurrent_ = false;
+      if (curDim == stateDim) {
+        // All blocks are connected, thus the compact ordering is the full one and the factorization
+        // of the last iteration is the one of the new information. Otherwise inf_LDLT_ is outdated
+        // (its version differs) and recomputed on the next GetInformationLDLT().
+        inf_LDLT_ = ws_.I_LDLT_;
+        infLDLTVersion_ = infVersion_;
+      }
+    }
     time_ = t;
-    LOG(INFO) << "state after Update:";
-    LOG(INFO) << state_.Print();
+    GIF_TRACE(1) << "state after Update:";
+    GIF_TRACE(1) << state_.Print();
 
     // Post Processing
     PostProcess();
@@ -377,6 +664,14 @@ class Filter {
     }
   }
 
+  void SetUpdateSolver(UpdateSolver solver){
+    solver_ = solver;
+  }
+
+  void SetMarginalizationRatio(double ratio){
+    marginalizationRatio_ = ratio;
+  }
+
   void TestJacs(const double delta, const double th, int i){
     LOG(INFO) << "==== Testing " << residuals_.at(i).res_->name_ << " ====" << std::endl;
     residuals_.at(i).res_->TestJacs(delta, th);
@@ -407,21 +702,99 @@ class Filter {
   MatX GetCovariance(){
     LOG_IF(ERROR,!is_initialized_) << "Accessing cov before initialization";
     const int stateDim = stateDefinition_->GetDim();
-    return (inf_).ldlt().solve(GIF::MatX::Identity(stateDim,stateDim));
+    if (solver_ == SOLVER_SQUARE_ROOT) {
+      // cov = inv(R)*inv(R)^T, only requires a triangular inversion
+      SyncSqrtInformation();
+      MatX sqrtCov = sqrtInf_.triangularView<Eigen::Upper>().solve(
+          GIF::MatX::Identity(stateDim,stateDim));
+      return sqrtCov * sqrtCov.transpose();
+    }
+    return GetInformationLDLT().solve(GIF::MatX::Identity(stateDim,stateDim));
+  }
+
+  /*! \brief Returns the joint covariance of the given state elements (in the given order) without
+   *         inverting the full information matrix. Uses the square-root factor or the cached LDLT
+   *         factorization of the information, the latter is reused until the next modification.
+   */
+  MatX GetMarginalCovariance(const std::vector<std::string>& names){
+    LOG_IF(ERROR,!is_initialized_) << "Accessing cov before initialization";
+    const int stateDim = stateDefinition_->GetDim();
+    std::vector<int> outer;
+    int dim = 0;
+    int minStart = stateDim;
+    for (const auto& name : names) {
+      const int outer_index = StateDefinition()->FindName(name);
+      LOG_IF(FATAL, outer_index == -1) << "No element with name "
+                                       << name << " for GetMarginalCovariance!";
+      outer.push_back(outer_index);
+      dim += StateDefinition()->GetElementDescription(outer_index)->GetDim();
+      minStart = std::min(minStart, StateDefinition()->GetStart(outer_index));
+    }
+    MatX E = MatX::Zero(stateDim, dim);
+    int count = 0;
+    for (const auto& j : outer) {
+      const int d = StateDefinition()->GetElementDescription(j)->GetDim();
+      E.block(StateDefinition()->GetStart(j), count, d, d).setIdentity();
+      count += d;
+    }
+    if (solver_ == SOLVER_SQUARE_ROOT) {
+      // cov = inv(R)*inv(R)^T, thus the requested block is X^T*X with X = inv(R^T)*E. The rows of
+      // X above the first requested element vanish since R^T is lower triangular.
+      SyncSqrtInformation();
+      const int len = stateDim - minStart;
+      MatX X = sqrtInf_.bottomRightCorner(len, len).transpose()
+          .triangularView<Eigen::Lower>().solve(E.bottomRows(len));
+      return X.transpose() * X;
+    }
+    MatX X = GetInformationLDLT().solve(E);
+    MatX cov(dim, dim);
+    count = 0;
+    for (const auto& j : outer) {
+      const int d = StateDefinition()->GetElementDescription(j)->GetDim();
+      cov.middleRows(count, d) = X.middleRows(StateDefinition()->GetStart(j), d);
+      count += d;
+    }
+    return cov;
   }
 
   void SetCovariance(MatX cov){
     LOG_IF(ERROR,!is_initialized_) << "Accessing cov before initialization";
     const int stateDim = stateDefinition_->GetDim();
     inf_ = (cov).ldlt().solve(GIF::MatX::Identity(stateDim,stateDim));
+    infIsCurrent_ = true;
+    sqrtInfIsCurrent_ = false;
+    infVersion_++;
   }
 
+  // Writable block of the information matrix (invalidates the square-root factor)
   inline MatRefX GetNoiseInfBlock(int i){
+    SyncInformation();
+    sqrtInfIsCurrent_ = false;
+    infVersion_++;
     const int dim = StateDefinition()->GetElementDescription(i)->GetDim();
     const int start = StateDefinition()->GetStart(i);
     return inf_.block(start,start,dim,dim);
   }
 
+  /*! \brief Returns the LDLT factorization of the information matrix. It is shared with the update
+   *         step (fully connected case) and only recomputed if the information was modified since,
+   *         consumers can compare GetInformationVersion() to reuse quantities derived from it.
+   */
+  const Eigen::LDLT<MatX>& GetInformationLDLT() {
+    SyncInformation();
+    if (infLDLTVersion_ != infVersion_) {
+      inf_LDLT_.compute(inf_);
+      LOG_IF(ERROR,inf_LDLT_.info() != Eigen::Success) << "Factorization of inf failed";
+      infLDLTVersion_ = infVersion_;
+    }
+    return inf_LDLT_;
+  }
+
+  // Incremented whenever the information (inf_ or sqrtInf_) is modified
+  unsigned long GetInformationVersion() const {
+    return infVersion_;
+  }
+
   inline MatRefX GetNoiseInfBlock(const std::string& str){
     const int outer_index = StateDefinition()->FindName(str);
     LOG_IF(FATAL, outer_index == -1) << "No element with name "
@@ -475,6 +848,427 @@ class Filter {
   }
 
  protected:
+  /*! \brief Marks all state elements which are connected to an active residual, either via the
+   *         previous (previous == true) or the current state. blockStart holds the start index of
+   *         each element within the compact ordering of the connected elements (-1 if not
+   *         connected). Returns the dimension of the compact ordering.
+   */
+  int ComputeConnectedBlocks(std::vector<int>& blockStart, bool previous) const {
+    blockStart.assign(stateDefinition_->GetNumElements(), -1);
+    for (int i = 0; i < residuals_.size(); i++) {
+      if (residuals_.at(i).isActive_) {
+        const std::vector<int>& outer = previous ? residuals_.at(i).preOuter_
+                                                 : residuals_.at(i).curOuter_;
+        for (const auto& j : outer) {
+          blockStart.at(j) = 0;
+        }
+      }
+    }
+    int dim = 0;
+    for (int j = 0; j < blockStart.size(); j++) {
+      if (blockStart.at(j) != -1) {
+        blockStart.at(j) = dim;
+        dim += stateDefinition_->GetElementDescription(j)->GetDim();
+      }
+    }
+    return dim;
+  }
+
+  void EmbedConnectedJacobian(MatRefX out, const MatX& in, const ElementVectorDefinition& def,
+                              const std::vector<int>& outer, const std::vector<int>& blockStart,
+                              int rowOffset) const {
+    for (int j = 0; j < outer.size(); j++) {
+      const int dim = def.GetElementDescription(j)->GetDim();
+      out.block(rowOffset, blockStart.at(outer.at(j)), in.rows(), dim) =
+          in.block(0, def.GetStart(j), in.rows(), dim);
+    }
+  }
+
+  // Adds the compact matrix in to the connected blocks of the full matrix out
+  void AddConnectedBlocks(MatRefX out, const MatCRefX& in, const std::vector<int>& rowBlockStart,
+                          const std::vector<int>& colBlockStart) const {
+    for (int i = 0; i < rowBlockStart.size(); i++) {
+      if (rowBlockStart.at(i) == -1) {
+        continue;
+      }
+      const int rows = stateDefinition_->GetElementDescription(i)->GetDim();
+      for (int j = 0; j < colBlockStart.size(); j++) {
+        if (colBlockStart.at(j) == -1) {
+          continue;
+        }
+        const int cols = stateDefinition_->GetElementDescription(j)->GetDim();
+        out.block(stateDefinition_->GetStart(i), stateDefinition_->GetStart(j), rows, cols) +=
+            in.block(rowBlockStart.at(i), colBlockStart.at(j), rows, cols);
+      }
+    }
+  }
+
+  // Adds the rows of the compact matrix in to the connected rows of the full matrix out
+  void AddConnectedRows(MatRefX out, const MatCRefX& in, const std::vector<int>& blockStart) const {
+    for (int i = 0; i < blockStart.size(); i++) {
+      if (blockStart.at(i) != -1) {
+        const int dim = stateDefinition_->GetElementDescription(i)->GetDim();
+        out.middleRows(stateDefinition_->GetStart(i), dim) += in.middleRows(blockStart.at(i), dim);
+      }
+    }
+  }
+
+  // Adds the columns of the compact matrix in to the connected columns of the full matrix out
+  void AddConnectedCols(MatRefX out, const MatCRefX& in, const std::vector<int>& blockStart) const {
+    for (int i = 0; i < blockStart.size(); i++) {
+      if (blockStart.at(i) != -1) {
+        const int dim = stateDefinition_->GetElementDescription(i)->GetDim();
+        out.middleCols(stateDefinition_->GetStart(i), dim) += in.middleCols(blockStart.at(i), dim);
+      }
+    }
+  }
+
+  // Extracts the connected blocks of the full matrix in into the compact matrix out
+  void GatherConnectedBlocks(MatRefX out, const MatCRefX& in,
+                             const std::vector<int>& rowBlockStart,
+                             const std::vector<int>& colBlockStart) const {
+    for (int i = 0; i < rowBlockStart.size(); i++) {
+      if (rowBlockStart.at(i) == -1) {
+        continue;
+      }
+      const int rows = stateDefinition_->GetElementDescription(i)->GetDim();
+      for (int j = 0; j < colBlockStart.size(); j++) {
+        if (colBlockStart.at(j) == -1) {
+          continue;
+        }
+        const int cols = stateDefinition_->GetElementDescription(j)->GetDim();
+        out.block(rowBlockStart.at(i), colBlockStart.at(j), rows, cols) =
+            in.block(stateDefinition_->GetStart(i), stateDefinition_->GetStart(j), rows, cols);
+      }
+    }
+  }
+
+  // Adds a matrix over the previous state of a residual to the connected blocks of the compact out
+  void AddResidualPreBlocks(MatRefX out, const MatCRefX& in, const ResidualStruct& rs) const {
+    const ElementVectorDefinition& def = *rs.res_->PreDefinition();
+    for (int i = 0; i < rs.preOuter_.size(); i++) {
+      const int rows = def.GetElementDescription(i)->GetDim();
+      for (int j = 0; j < rs.preOuter_.size(); j++) {
+        const int cols = def.GetElementDescription(j)->GetDim();
+        out.block(preBlockStart_.at(rs.preOuter_.at(i)), preBlockStart_.at(rs.preOuter_.at(j)),
+                  rows, cols) += in.block(def.GetStart(i), def.GetStart(j), rows, cols);
+      }
+    }
+  }
+
+  /*! \brief Computes jacNoi_*R of a residual according to its noise structure, where R is the
+   *         block-diagonal noise covariance scaled by the individual noise weightings.
+   */
+  void ComputeWeightedNoiseJacobian(ResidualStruct& rs) const {
+    const ElementVectorDefinition& noiDef = *rs.res_->NoiDefinition();
+    const MatX& R = rs.res_->GetNoiseCovariance();
+    for (int j = 0; j < noiDef.GetNumElements(); j++) {
+      const int start = noiDef.GetStart(j);
+      const int dim = noiDef.GetElementDescription(j)->GetDim();
+      const double weight = rs.res_->GetNoiseWeighting(rs.inn_, j);
+      const double scale = 1/(weight*weight);
+      if (rs.res_->noiseStructure_ == BinaryResidualBase::NOISE_DIAGONAL) {
+        DLOG_IF(ERROR,!R.block(start, start, dim, dim).isDiagonal())
+            << "Noise covariance of " << rs.res_->name_ << " is not diagonal but NOISE_DIAGONAL "
+            << "is set, the off-diagonal entries are ignored!";
+        for (int k = start; k < start + dim; k++) {
+          rs.jacNoiR_.col(k) = rs.jacNoi_.col(k) * (scale*R(k, k));
+        }
+      } else {
+        rs.jacNoiR_.middleCols(start, dim).noalias() =
+            rs.jacNoi_.middleCols(start, dim) * R.block(start, start, dim, dim);
+        rs.jacNoiR_.middleCols(start, dim) *= scale;
+      }
+    }
+  }
+
+  /*! \brief Computes Jpre^T*inv(W)*Jpre of a random walk residual with diagonal noise. Since
+   *         Jnoi = sqrt(dt)*Jpre, it is the diagonal inv(dt*R) (scaled by the noise weightings)
+   *         and neither depends on the Jacobians nor requires a solve with W.
+   */
+  void ComputeRandomWalkInformation(ResidualStruct& rs) const {
+    const ElementVectorDefinition& noiDef = *rs.res_->NoiDefinition();
+    const MatX& R = rs.res_->GetNoiseCovariance();
+    rs.JacPreWinvJacPre_.setZero();
+    for (int j = 0; j < noiDef.GetNumElements(); j++) {
+      const int start = noiDef.GetStart(j);
+      const int dim = noiDef.GetElementDescription(j)->GetDim();
+      const double weight = rs.res_->GetNoiseWeighting(rs.inn_, j);
+      const double scale = rs.res_->dt_/(weight*weight);
+      for (int k = start; k < start + dim; k++) {
+        rs.JacPreWinvJacPre_(k, k) = 1/(scale*R(k, k));
+      }
+    }
+  }
+
+  // Solves W*X = B in place (X holds B on input), block-wise per residual if no noise is shared
+  void SolveWeightingInPlace(int innDim, MatRefX X) const {
+    if (sharedNoise_) {
+      ws_.W_LDLT_.solveInPlace(X);
+      return;
+    }
+    int count = 0;
+    for (int i = 0; i < residuals_.size(); i++) {
+      if (residuals_.at(i).isActive_) {
+        const ResidualStruct& rs = residuals_.at(i);
+        auto Xi = X.middleRows(count, rs.innDim_);
+        rs.W_LDLT_.solveInPlace(Xi);
+        count += rs.innDim_;
+      }
+    }
+  }
+
+  // Computes inv(L)*X in place for W = L*L^T, block-wise per residual if no noise is shared
+  void WhitenInPlace(int innDim, MatRefX X) const {
+    if (sharedNoise_) {
+      ws_.W_LLT_.matrixL().solveInPlace(X);
+      return;
+    }
+    int count = 0;
+    for (int i = 0; i < residuals_.size(); i++) {
+      if (residuals_.at(i).isActive_) {
+        const ResidualStruct& rs = residuals_.at(i);
+        auto Xi = X.middleRows(count, rs.innDim_);
+        rs.W_LLT_.matrixL().solveInPlace(Xi);
+        count += rs.innDim_;
+      }
+    }
+  }
+
+  // Recomputes inf_ = sqrtInf_^T*sqrtInf_ if the square-root factor was modified last
+  void SyncInformation() {
+    if (!infIsCurrent_) {
+      inf_.noalias() = sqrtInf_.transpose() * sqrtInf_.triangularView<Eigen::Upper>();
+      infIsCurrent_ = true;
+    }
+  }
+
+  // Recomputes the upper triangular sqrtInf_ from inf_ if the latter was modified last
+  void SyncSqrtInformation() {
+    if (!sqrtInfIsCurrent_) {
+      Eigen::LLT<MatX> inf_LLT(inf_);
+      LOG_IF(ERROR,inf_LLT.info() != Eigen::Success) << "Cholesky factorization of inf failed";
+      sqrtInf_ = inf_LLT.matrixU();
+      sqrtInfIsCurrent_ = true;
+    }
+  }
+
+  /*! \brief Computes D = inf + Jpre^T*inv(W)*Jpre restricted to the connected previous blocks (in
+   *         DinvPre_ ordering) and its factorization. Unconnected previous blocks only enter through
+   *         the prior, they are marginalized in closed form such that D never spans the full state.
+   *         If the factorization of inf is up to date (e.g. after a fully connected update) and
+   *         the unconnected part dominates (see kMarginalizationRatio), the marginal information is obtained as the inverse of
+   *         the corresponding covariance block. Otherwise the Schur complement
+   *         inf_PP - inf_PU*inv(inf_UU)*inf_UP is used, which vanishes if inf_UP is zero. If no
+   *         noise is shared, Jpre^T*inv(W)*Jpre is summed per residual over its own previous
+   *         elements only, random walks directly contribute inv(dt*R) (see isRandomWalk_).
+   *         Requires WinvJacPre_ in the shared noise case.
+   */
+  void ComputeD(int innDim, int preDim) {
+    UpdateWorkspace& ws = ws_;
+    const int stateDim = stateDefinition_->GetDim();
+    auto D = ws.D_.topLeftCorner(preDim, preDim);
+    if (preDim == stateDim) {
+      D = inf_;  // Compact ordering is the full one
+    } else if (preDim > 0) {
+      const int uDim = stateDim - preDim;
+      if (infLDLTVersion_ == infVersion_ && uDim > marginalizationRatio_ * preDim) {
+        // Solving with the available factorization is cheaper than factorizing inf_UU
+        auto infInvP = ws.infInvP_.topLeftCorner(stateDim, preDim);
+        infInvP.setZero();
+        for (int j = 0; j < preBlockStart_.size(); j++) {
+          if (preBlockStart_.at(j) != -1) {
+            const int dim = stateDefinition_->GetElementDescription(j)->GetDim();
+            infInvP.block(stateDefinition_->GetStart(j), preBlockStart_.at(j), dim, dim)
+                .setIdentity();
+          }
+        }
+        inf_LDLT_.solveInPlace(infInvP);
+        auto covPP = ws.infUU_.topLeftCorner(preDim, preDim);
+        for (int j = 0; j < preBlockStart_.size(); j++) {
+          if (preBlockStart_.at(j) != -1) {
+            const int dim = stateDefinition_->GetElementDescription(j)->GetDim();
+            covPP.middleRows(preBlockStart_.at(j), dim) =
+                infInvP.middleRows(stateDefinition_->GetStart(j), dim);
+          }
+        }
+        ws.P_LDLT_.compute(covPP);
+        LOG_IF(ERROR,ws.P_LDLT_.info() != Eigen::Success)
+            << "Factorization of marginal cov failed";
+        D.setIdentity();
+        ws.P_LDLT_.solveInPlace(D);
+      } else {
+        GatherConnectedBlocks(D, inf_, preBlockStart_, preBlockStart_);
+        preUnconnectedBlockStart_.assign(preBlockStart_.size(), -1);
+        int count = 0;
+        for (int j = 0; j < preBlockStart_.size(); j++) {
+          if (preBlockStart_.at(j) == -1) {
+            preUnconnectedBlockStart_.at(j) = count;
+            count += stateDefinition_->GetElementDescription(j)->GetDim();
+          }
+        }
+        auto infUP = ws.infUP_.topLeftCorner(uDim, preDim);
+        GatherConnectedBlocks(infUP, inf_, preUnconnectedBlockStart_, preBlockStart_);
+        if ((infUP.array() != 0.0).any()) {
+          auto infUU = ws.infUU_.topLeftCorner(uDim, uDim);
+          auto infUUinvUP = ws.infUUinvUP_.topLeftCorner(uDim, preDim);
+          GatherConnectedBlocks(infUU, inf_, preUnconnectedBlockStart_, preUnconnectedBlockStart_);
+          ws.U_LDLT_.compute(infUU);
+          LOG_IF(ERROR,ws.U_LDLT_.info() != Eigen::Success)
+              << "Factorization of unconnected inf failed";
+          infUUinvUP = infUP;
+          ws.U_LDLT_.solveInPlace(infUUinvUP);
+          D.noalias() -= infUP.transpose() * infUUinvUP;
+        }
+      }
+    }
+    if (sharedNoise_) {
+      auto JacPreWinvJacPre = ws.JacPreWinvJacPre_.topLeftCorner(preDim, preDim);
+      JacPreWinvJacPre.noalias() = ws.jacPre_.topLeftCorner(innDim, preDim).transpose()
+          * ws.WinvJacPre_.topLeftCorner(innDim, preDim);
+      D += JacPreWinvJacPre;
+    } else {
+      for (int i = 0; i < residuals_.size(); i++) {
+        if (residuals_.at(i).isActive_ && !residuals_.at(i).preOuter_.empty()) {
+          ResidualStruct& rs = residuals_.at(i);
+          if (rs.res_->isRandomWalk_
+              && rs.res_->noiseStructure_ == BinaryResidualBase::NOISE_DIAGONAL) {
+            ComputeRandomWalkInformation(rs);
+          } else {
+            rs.WinvJacPre_ = rs.jacPre_;
+            rs.W_LDLT_.solveInPlace(rs.WinvJacPre_);
+            rs.JacPreWinvJacPre_.noalias() = rs.jacPre_.transpose() * rs.WinvJacPre_;
+          }
+          AddResidualPreBlocks(D, rs.JacPreWinvJacPre_, rs);
+        }
+      }
+    }
+    ws.D_LDLT_.compute(D);
+    LOG_IF(ERROR,ws.D_LDLT_.info() != Eigen::Success) << "Factorization of D failed";
+  }
+
+  /*! \brief Computes the updated information on the connected current blocks (newInfCur_) and the
+   *         corresponding weighted innovation (Sy_) by forming the explicit inverses of W and D.
+   */
+  void ComputeInverseUpdate(int innDim, int preDim, int curDim) {
+    UpdateWorkspace& ws = ws_;
+    auto JacPre = ws.jacPre_.topLeftCorner(innDim, preDim);
+    auto JacCur = ws.jacCur_.topLeftCorner(innDim, curDim);
+    auto Winv = ws.Winv_.topLeftCorner(innDim, innDim);
+    auto WinvJacPre = ws.WinvJacPre_.topLeftCorner(innDim, preDim);
+    auto DinvPre = ws.DinvPre_.topLeftCorner(preDim, preDim);
+    auto M = ws.M_.topLeftCorner(innDim, innDim);
+    auto S = ws.S_.topLeftCorner(curDim, innDim);
+    Winv.setIdentity();
+    SolveWeightingInPlace(innDim, Winv);
+    WinvJacPre.noalias() = Winv * JacPre;
+    ComputeD(innDim, preDim);
+    DinvPre.setIdentity();
+    ws.D_LDLT_.solveInPlace(DinvPre);
+    ws.WinvJacPreDinv_.topLeftCorner(innDim, preDim).noalias() = WinvJacPre * DinvPre;
+    M = Winv;
+    M.noalias() -= ws.WinvJacPreDinv_.topLeftCorner(innDim, preDim) * WinvJacPre.transpose();
+    S.noalias() = JacCur.transpose() * M;
+    ws.newInfCur_.topLeftCorner(curDim, curDim).noalias() = S * JacCur;
+    ws.Sy_.head(curDim).noalias() = S * ws.y_.head(innDim);
+  }
+
+  /*! \brief Computes the updated information on the connected current blocks (newInfCur_) and the
+   *         corresponding weighted innovation (Sy_) without forming any explicit inverse. W and D
+   *         are only used through their factorizations, the previous information is marginalized
+   *         by solving with D for the stacked right hand side [Jpre^T*inv(W)*Jcur, Jpre^T*inv(W)*y].
+   */
+  void ComputeFactorizedUpdate(int innDim, int preDim, int curDim) {
+    UpdateWorkspace& ws = ws_;
+    auto JacPre = ws.jacPre_.topLeftCorner(innDim, preDim);
+    auto JacCur = ws.jacCur_.topLeftCorner(innDim, curDim);
+    auto y = ws.y_.head(innDim);
+    auto WinvJacPre = ws.WinvJacPre_.topLeftCorner(innDim, preDim);
+    auto WinvJacCur = ws.WinvJacCur_.topLeftCorner(innDim, curDim);
+    auto Winvy = ws.Winvy_.head(innDim);
+    WinvJacPre = JacPre;
+    SolveWeightingInPlace(innDim, WinvJacPre);
+    WinvJacCur = JacCur;
+    SolveWeightingInPlace(innDim, WinvJacCur);
+    Winvy = y;
+    SolveWeightingInPlace(innDim, Winvy);
+    ComputeD(innDim, preDim);
+    auto X = ws.X_.topLeftCorner(preDim, curDim + 1);
+    X.leftCols(curDim).noalias() = WinvJacPre.transpose() * JacCur;
+    X.col(curDim).noalias() = WinvJacPre.transpose() * y;
+    ws.D_LDLT_.solveInPlace(X);
+    auto JacCurWinvJacPre = ws.JacCurWinvJacPre_.topLeftCorner(curDim, preDim);
+    auto newInfCur = ws.newInfCur_.topLeftCorner(curDim, curDim);
+    auto Sy = ws.Sy_.head(curDim);
+    JacCurWinvJacPre.noalias() = WinvJacCur.transpose() * JacPre;
+    newInfCur.noalias() = JacCur.transpose() * WinvJacCur;
+    newInfCur.noalias() -= JacCurWinvJacPre * X.leftCols(curDim);
+    Sy.noalias() = JacCur.transpose() * Winvy;
+    Sy.noalias() -= JacCurWinvJacPre * X.col(curDim);
+  }
+
+  /*! \brief Computes the updated square-root information on the connected current blocks
+   *         (newSqrtInfCur_, upper triangular) and the corresponding whitened innovation (zCur_)
+   *         such that the increment is -inv(newSqrtInfCur_)*zCur_. The whitened system
+   *         [inv(L)*Jpre, inv(L)*Jcur, inv(L)*y] is stacked below [sqrtInf_, 0, 0] and
+   *         triangularized by Householder reflections. Since sqrtInf_ is already triangular, each
+   *         reflection of a previous state column only involves its diagonal row and the innovation
+   *         rows, the rows of sqrtInf_ are never modified. The remaining innovation rows are then
+   *         triangularized over the current columns.
+   */
+  void ComputeSquareRootUpdate(int innDim, int preDim, int curDim) {
+    UpdateWorkspace& ws = ws_;
+    const int stateDim = stateDefinition_->GetDim();
+    const int cols = stateDim + curDim + 1;
+    auto A = ws.sqrtA_.topLeftCorner(innDim, cols);
+    A.leftCols(stateDim).setZero();
+    AddConnectedCols(A.leftCols(stateDim), ws.jacPre_.topLeftCorner(innDim, preDim),
+                     preBlockStart_);
+    A.middleCols(stateDim, curDim) = ws.jacCur_.topLeftCorner(innDim, curDim);
+    A.col(stateDim + curDim) = ws.y_.head(innDim);
+    WhitenInPlace(innDim, A);
+
+    // Eliminate the previous state
+    for (int k = 0; k < stateDim; k++) {
+      auto v = A.col(k);
+      const double sigma = v.squaredNorm();
+      if (sigma == 0.0) {
+        continue;  // Nothing to eliminate (e.g. unconnected previous block without fill-in)
+      }
+      const double alpha = sqrtInf_(k, k);
+      const double norm = std::sqrt(alpha * alpha + sigma);
+      const double beta = alpha >= 0.0 ? -norm : norm;
+      const double tau = (beta - alpha) / beta;
+      v /= alpha - beta;  // Essential part of the Householder vector [1; v]
+      const int rest = cols - k - 1;
+      auto w = ws.householder_.head(rest);
+      w.noalias() = A.rightCols(rest).transpose() * v;
+      w.head(stateDim - k - 1) += sqrtInf_.row(k).tail(stateDim - k - 1).transpose();
+      w *= tau;
+      A.rightCols(rest).noalias() -= v * w.transpose();
+    }
+
+    // Triangularize the current state columns
+    auto C = A.rightCols(curDim + 1);
+    for (int c = 0; c < std::min(innDim - 1, curDim); c++) {
+      double tau;
+      double beta;
+      auto v = C.col(c).tail(innDim - c);
+      v.makeHouseholderInPlace(tau, beta);
+      C.bottomRightCorner(innDim - c, curDim - c).applyHouseholderOnTheLeft(
+          v.tail(innDim - c - 1), tau, ws.householder_.data());
+      v(0) = beta;
+      v.tail(innDim - c - 1).setZero();
+    }
+    const int rank = std::min(innDim, curDim);
+    LOG_IF(ERROR,rank < curDim) << "Square-root update is rank deficient";
+    auto newSqrtInfCur = ws.newSqrtInfCur_.topLeftCorner(curDim, curDim);
+    newSqrtInfCur.setZero();
+    newSqrtInfCur.topRows(rank).triangularView<Eigen::Upper>() = C.topLeftCorner(rank, curDim);
+    ws.zCur_.head(curDim).setZero();
+    ws.zCur_.head(rank) = C.col(curDim).head(rank);
+  }
+
   ElementVectorDefinition::Ptr stateDefinition_; // Must come before state
   ElementVectorDefinition::Ptr noiseDefinition_;
   std::vector<ResidualStruct> residuals_;
@@ -484,10 +1278,27 @@ class Filter {
   ElementVector noise_;
   ElementVector curLinState_;
   MatX inf_;
+  MatX sqrtInf_;            // Upper triangular with inf_ = sqrtInf_^T*sqrtInf_ (SOLVER_SQUARE_ROOT)
+  bool infIsCurrent_;       // Whether inf_ reflects the latest information
+  bool sqrtInfIsCurrent_;   // Whether sqrtInf_ reflects the latest information
+  unsigned long infVersion_;
+  Eigen::LDLT<MatX> inf_LDLT_;
+  unsigned long infLDLTVersion_;  // Information version inf_LDLT_ was computed for
   bool is_initialized_;
+  bool sharedNoise_;  // Whether several residuals share noise elements
   bool include_max_;
+  MeasurementBuffer updateEvents_;  // Merged measurement times of all non-mergeable residuals
+                                   // (sorted, unique, without measurements)
+  std::vector<TimePoint> updateTimes_;  // Update times of the current Update() (reused)
+  TimePoint lastMeasTime_;            // Latest time added to any measurement timeline
   int num_iter_;
   double iter_th_;
+  UpdateSolver solver_;
+  double marginalizationRatio_;  // See kMarginalizationRatio
+  std::vector<int> preBlockStart_;
+  std::vector<int> preUnconnectedBlockStart_;  // Compact start of unconnected previous elements
+  std::vector<int> curBlockStart_;
+  UpdateWorkspace ws_;
 };
 
 }
@@ -59,6 +59,14 @@ class BlindMavFilter: public GIF::Filter{
   int height_update_id_;
   int height_prediction_id_;
 
+  // Outer indices of state elements used during linearization
+  int IrIM_outer_;
+  int qIM_outer_;
+  int MvM_outer_;
+  int MwM_outer_;
+  int MwM_bias_outer_;
+  int MfM_bias_outer_;
+
   // Init Covariances
   double MwM_bias_init_;
   double MfM_bias_init_;
@@ -157,6 +165,12 @@ class BlindMavFilter: public GIF::Filter{
     }
     std::cout << PrintConnectivity();
     initState_.Construct();
+    IrIM_outer_ = stateDefinition_->FindName("IrIM");
+    qIM_outer_ = stateDefinition_->FindName("qIM");
+    MvM_outer_ = stateDefinition_->FindName("MvM");
+    MwM_outer_ = stateDefinition_->FindName("MwM");
+    MwM_bias_outer_ = stateDefinition_->FindName("MwM_bias");
+    MfM_bias_outer_ = stateDefinition_->FindName("MfM_bias");
 
     SetIterationParameters(10,0.1);
     SetDynCalibrationFlags(0,0,0,0,0,0,0,0);
@@ -196,15 +210,16 @@ class BlindMavFilter: public GIF::Filter{
       std::shared_ptr<const GIF::RorMeas> gyr = std::dynamic_pointer_cast<const GIF::RorMeas>(gyrMeas);
 
       const double dt = GIF::toSec(t-time_);
-      curLinState_.GetValue<GIF::Vec3>("MwM") = gyr->MwM_ - state_.GetValue<GIF::Vec3>("MwM_bias");
-      curLinState_.GetValue<GIF::Vec3>("IrIM") = state_.GetValue<GIF::Vec3>("IrIM")
-          + dt * state_.GetValue<GIF::Quat>("qIM").rotate(state_.GetValue<GIF::Vec3>("MvM"));
-      curLinState_.GetValue<GIF::Vec3>("MvM") =
-          (GIF::Mat3::Identity() - GIF::gSM(dt * state_.GetValue<GIF::Vec3>("MwM"))) * state_.GetValue<GIF::Vec3>("MvM")
-          + dt * (acc->MfM_ - state_.GetValue<GIF::Vec3>("MfM_bias")
-                  + state_.GetValue<GIF::Quat>("qIM").inverseRotate(GIF::Vec3(0,0,-9.81)));
-      GIF::Quat dQ = dQ.exponentialMap(dt * state_.GetValue<GIF::Vec3>("MwM"));
-      curLinState_.GetValue<GIF::Quat>("qIM") = state_.GetValue<GIF::Quat>("qIM") * dQ;
+      curLinState_.GetValue<GIF::Vec3>(MwM_outer_) = gyr->MwM_ - state_.GetValue<GIF::Vec3>(MwM_bias_outer_);
+      curLinState_.GetValue<GIF::Vec3>(IrIM_outer_) = state_.GetValue<GIF::Vec3>(IrIM_outer_)
+          + dt * state_.GetValue<GIF::Quat>(qIM_outer_).rotate(state_.GetValue<GIF::Vec3>(MvM_outer_));
+      curLinState_.GetValue<GIF::Vec3>(MvM_outer_) =
+          (GIF::Mat3::Identity() - GIF::gSM(dt * state_.GetValue<GIF::Vec3>(MwM_outer_))) * state_.GetValue<GIF::Vec3>(MvM_outer_)
+          + dt * (acc->MfM_ - state_.GetValue<GIF::Vec3>(MfM_bias_outer_)
+                  - GIF::gSM(acc->MfM_mom_) * state_.GetValue<GIF::Vec3>(MwM_outer_)
+                  + state_.GetValue<GIF::Quat>(qIM_outer_).inverseRotate(GIF::Vec3(0,0,-9.81)));
+      GIF::Quat dQ = dQ.exponentialMap(dt * state_.GetValue<GIF::Vec3>(MwM_outer_));
+      curLinState_.GetValue<GIF::Quat>(qIM_outer_) = state_.GetValue<GIF::Quat>(qIM_outer_) * dQ;
     }
   }
   void Init(const GIF::TimePoint& t = GIF::TimePoint::min(), const GIF::ElementVectorBase* initState = nullptr) {
@@ -1,7 +1,8 @@
 #ifndef GIF_MEASUREMENT_HPP_
 #define GIF_MEASUREMENT_HPP_
-#include <map>
-#include <set>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
 
 #include "element-vector.h"
 #include "generalized_information_filter/common.h"
@@ -13,8 +14,207 @@ class EmptyMeas : public ElementVector {
   EmptyMeas(): ElementVector(std::make_shared<ElementVectorDefinition>()){};
 };
 
+/*! \brief FreeList
+ *         Lock-free list of recycled blocks, each providing storage for one T. Every block carries
+ *         an intrusive link in front of its storage, such that recycling never allocates. Released
+ *         blocks are pushed onto a shared Treiber stack. Acquiring threads take over the whole
+ *         stack at once (an exchange, which in contrast to popping single blocks is not prone to
+ *         ABA) and pop from this thread-local list, which is handed back when the thread exits.
+ *         If both are empty the pool is exhausted: Acquire returns nullptr and the caller gets a
+ *         fresh block from NewBlock, which joins the pool when released. Blocks are never returned
+ *         to the heap, such that the allocations stop once the high-water mark has been reached.
+ */
+template<typename T>
+class FreeList {
+ public:
+  static FreeList& Instance() {
+    // Intentionally leaked, blocks may be released during static destruction
+    static FreeList* instance = new FreeList();
+    return *instance;
+  }
+  void* Acquire() {  // Returns nullptr if exhausted
+    LocalList& local = Local();
+    if (local.head_ == nullptr) {
+      local.head_ = head_.exchange(nullptr, std::memory_order_acquire);
+      if (local.head_ == nullptr) {
+        return nullptr;
+      }
+    }
+    Node* node = local.head_;
+    local.head_ = node->next_;
+    return &node->storage_;
+  }
+  void Release(void* block) {
+    Push(reinterpret_cast<Node*>(static_cast<char*>(block) - offsetof(Node, storage_)));
+  }
+  void* NewBlock() {  // Allocates a new block (the only heap allocation of the pool)
+    numBlocks_.fetch_add(1, std::memory_order_relaxed);
+    return &(new Node())->storage_;
+  }
+  int GetNumBlocks() const {  // Number of blocks allocated so far (in use or free)
+    return numBlocks_.load(std::memory_order_relaxed);
+  }
+ protected:
+  struct Node {
+    Node* next_;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  };
+  struct LocalList {
+    Node* head_ = nullptr;
+    ~LocalList() {
+      while (head_ != nullptr) {
+        Node* node = head_;
+        head_ = node->next_;
+        Instance().Push(node);
+      }
+    }
+  };
+  FreeList(): head_(nullptr), numBlocks_(0) {
+  }
+  static LocalList& Local() {
+    static thread_local LocalList local;
+    return local;
+  }
+  void Push(Node* node) {
+    node->next_ = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(node->next_, node, std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+  std::atomic<Node*> head_;
+  std::atomic<int> numBlocks_;
+};
+
+/*! \brief PoolAllocator
+ *         Allocator recycling single objects through the free list of their type. Used for the
+ *         control blocks of pooled shared pointers.
+ */
+template<typename T>
+class PoolAllocator {
+ public:
+  typedef T value_type;
+  PoolAllocator() {
+  }
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>&) {
+  }
+  T* allocate(std::size_t n) {
+    if (n == 1) {
+      void* block = FreeList<T>::Instance().Acquire();
+      return static_cast<T*>(block != nullptr ? block : FreeList<T>::Instance().NewBlock());
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T* p, std::size_t n) {
+    if (n == 1) {
+      FreeList<T>::Instance().Release(p);
+    } else {
+      ::operator delete(p);
+    }
+  }
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+/*! \brief MeasurementPool
+ *         Per-type pool of measurements. The returned shared pointers hand the measurement back
+ *         to the pool instead of destructing it, their control blocks are recycled as well. Get
+ *         and the release are lock-free (see FreeList). If the pool is exhausted a new measurement
+ *         is allocated, thus at steady measurement rates no heap allocation takes place once the
+ *         high-water mark has been reached (Reserve pre-fills the pool). Measurements must be
+ *         default constructible, Make additionally requires a Set method taking the constructor
+ *         arguments.
+ */
+template<typename Meas>
+class MeasurementPool {
+ public:
+  // Recycled or newly constructed measurement, all elements are reset to identity
+  static std::shared_ptr<Meas> Get() {
+    Meas* meas = static_cast<Meas*>(FreeList<Meas>::Instance().Acquire());
+    if (meas == nullptr) {
+      meas = new (FreeList<Meas>::Instance().NewBlock()) Meas();
+    }
+    meas->SetIdentity();
+    return std::shared_ptr<Meas>(meas, Recycler(), PoolAllocator<Meas>());
+  }
+
+  template<typename ... Args>
+  static std::shared_ptr<Meas> Make(const Args&... args) {
+    std::shared_ptr<Meas> meas = Get();
+    meas->Set(args...);
+    return meas;
+  }
+
+  // Number of measurements allocated so far (in use or pooled)
+  static int GetNumAllocated() {
+    return FreeList<Meas>::Instance().GetNumBlocks();
+  }
+
+  // Pre-fills the pool such that the first n measurements do not allocate either
+  static void Reserve(int n) {
+    std::vector<std::shared_ptr<Meas>> meas(n);
+    for (int i = 0; i < n; i++) {
+      meas[i] = Get();
+    }
+  }
+
+ protected:
+  struct Recycler {
+    void operator()(Meas* meas) const {
+      FreeList<Meas>::Instance().Release(meas);
+    }
+  };
+};
+
 class BinaryResidualBase;
 
+/*! \brief MeasurementBuffer
+ *         Time-sorted ring buffer of measurements. Appending in chronological order and removing
+ *         the oldest measurement are O(1) and allocation-free once the capacity suffices, the rare
+ *         out-of-order measurement is inserted by shifting the later ones (insertion sort). Entries
+ *         are addressed by their index in chronological order.
+ */
+class MeasurementBuffer {
+ public:
+  struct Entry {
+    TimePoint t_;
+    ElementVectorBase::CPtr meas_;
+  };
+  MeasurementBuffer(int capacity = 16);
+  virtual ~MeasurementBuffer();
+  inline int Size() const;
+  inline bool Empty() const;
+  inline Entry& At(int k);
+  inline const Entry& At(int k) const;
+  inline Entry& Front();
+  inline const Entry& Front() const;
+  inline Entry& Back();
+  inline const Entry& Back() const;
+  void PushBack(const TimePoint& t, const ElementVectorBase::CPtr& meas);
+  void PopFront();
+  void Insert(int k, const TimePoint& t, const ElementVectorBase::CPtr& meas);
+  void Erase(int k);
+  void Replace(int begin, int end, const std::vector<Entry>& entries);  // Replaces [begin, end)
+  void Clear();
+  int LowerBound(const TimePoint& t) const;  // First index with time >= t (Size() if none)
+  int UpperBound(const TimePoint& t) const;  // First index with time > t (Size() if none)
+  int Find(const TimePoint& t) const;        // Index with time == t (-1 if none)
+ protected:
+  void Grow();
+  std::vector<Entry> entries_;  // Size is a power of two
+  int mask_;
+  int head_;
+  int size_;
+};
+
 /*! \brief MeasurementTimeline
  *         Class for managing measurements in a timeline. Provides various helpers.
  *         Assume: last_processed_time_ is always smaller than all other measurement times.
@@ -24,7 +224,7 @@ class MeasurementTimeline {
   MeasurementTimeline(const bool ignore_first, const Duration& max_wait_time,
                       const Duration& min_wait_time);
   virtual ~MeasurementTimeline();
-  void AddMeasurement(const ElementVectorBase::CPtr& meas, const TimePoint& t);
+  bool AddMeasurement(const ElementVectorBase::CPtr& meas, const TimePoint& t);  // True if added
   bool GetMeasurement(const TimePoint& t, ElementVectorBase::CPtr& meas);
   void RemoveProcessedFirst();
   void Reset();
@@ -32,26 +232,88 @@ class MeasurementTimeline {
   TimePoint GetFirstTime() const;
   bool GetFirst(ElementVectorBase::CPtr& meas);
   TimePoint GetMaximalUpdateTime(const TimePoint& current_time) const;
-  void GetAllInRange(std::set<TimePoint>& times, const TimePoint& start,
+  // Append the times within (start, end] to times (in chronological order)
+  void GetAllInRange(std::vector<TimePoint>& times, const TimePoint& start,
                      const TimePoint& end) const;
-  void GetLastInRange(std::set<TimePoint>& times, const TimePoint& start,
+  void GetLastInRange(std::vector<TimePoint>& times, const TimePoint& start,
                       const TimePoint& end) const;
+  // The following take strictly increasing times
   void Split(const TimePoint& t0, const TimePoint& t1, const TimePoint& t2,
              const BinaryResidualBase* res);
-  void Split(const std::set<TimePoint>& times, const BinaryResidualBase* res);
+  void Split(const std::vector<TimePoint>& times, const BinaryResidualBase* res);
   void Merge(const TimePoint& t0, const TimePoint& t1, const TimePoint& t2,
              const BinaryResidualBase* res);
-  void MergeUndesired(const std::set<TimePoint>& times, const BinaryResidualBase* res);
+  void MergeUndesired(const std::vector<TimePoint>& times, const BinaryResidualBase* res);
   void RemoveOutdated(const TimePoint& time);
   std::string Print(const TimePoint& start, int start_offset, double resolution) const;
   TimePoint GetLastProcessedTime() const;
  protected:
-  std::map<TimePoint, ElementVectorBase::CPtr> meas_map_;
+  MeasurementBuffer meas_;
+  std::vector<MeasurementBuffer::Entry> scratch_;  // Rebuilt part of the timeline (Split/Merge)
+  std::vector<TimePoint> runTimes_;                // Times of the run handed to the residual
+  std::vector<ElementVectorBase::CPtr> runMeas_;   // Measurements of the run
   Duration max_wait_time_;
   Duration min_wait_time_; // Should always be zero for binary residual
   TimePoint last_processed_time_;
   bool drop_first_;
 };
 
+/*! \brief MeasurementQueue
+ *         Lock-free single-producer single-consumer ring buffer of timestamped measurements. Allows a
+ *         sensor thread to hand over measurements without blocking the thread running the filter.
+ *         Push may only be called from one producer thread and Pop from one consumer thread.
+ */
+class MeasurementQueue {
+ public:
+  MeasurementQueue(int capacity);
+  virtual ~MeasurementQueue();
+  bool Push(const ElementVectorBase::CPtr& meas, const TimePoint& t);
+  bool Pop(ElementVectorBase::CPtr& meas, TimePoint& t);
+  int GetCapacity() const;
+ protected:
+  struct Entry {
+    ElementVectorBase::CPtr meas_;
+    TimePoint t_;
+  };
+  std::vector<Entry> entries_;  // Size is a power of two
+  const size_t mask_;
+  std::atomic<size_t> head_;  // Next entry to pop, only written by the consumer
+  char padding_[64];          // Keeps head_ and tail_ on separate cache lines
+  std::atomic<size_t> tail_;  // Next entry to push, only written by the producer
+};
+
+// ==================== Implementation ==================== //
+int MeasurementBuffer::Size() const {
+  return size_;
+}
+
+bool MeasurementBuffer::Empty() const {
+  return size_ == 0;
+}
+
+MeasurementBuffer::Entry& MeasurementBuffer::At(int k) {
+  return entries_[(head_ + k) & mask_];
+}
+
+const MeasurementBuffer::Entry& MeasurementBuffer::At(int k) const {
+  return entries_[(head_ + k) & mask_];
+}
+
+MeasurementBuffer::Entry& MeasurementBuffer::Front() {
+  return At(0);
+}
+
+const MeasurementBuffer::Entry& MeasurementBuffer::Front() const {
+  return At(0);
+}
+
+MeasurementBuffer::Entry& MeasurementBuffer::Back() {
+  return At(size_ - 1);
+}
+
+const MeasurementBuffer::Entry& MeasurementBuffer::Back() const {
+  return At(size_ - 1);
+}
+
 }
 #endif /* GIF_MEASUREMENT_HPP_ */
@@ -6,17 +6,25 @@
 namespace GIF {
 
 /*! \brief Accelerometer Measurement of Imu
- *         ElementVector that can be used to hold acceleromter measurement.
+ *         ElementVector that can be used to hold acceleromter measurement. Merged (preintegrated)
+ *         measurements hold the mean over their interval T and its first moment about the interval
+ *         center (1/T * integral of (t - T/2) * MfM(t) dt), the latter is zero for single samples.
  */
 class AccMeas : public ElementVector {
  public:
   AccMeas(const Vec3& MfM = Vec3(0, 0, 0))
       : ElementVector(std::shared_ptr<ElementVectorDefinition>(
-            new ElementPack<Vec3, Vec3>({"MfM"}))),
-        MfM_(ElementVector::GetValue<Vec3>("MfM")) {
+            new ElementPack<Vec3, Vec3>({"MfM", "MfM_mom"}))),
+        MfM_(ElementVector::GetValue<Vec3>("MfM")),
+        MfM_mom_(ElementVector::GetValue<Vec3>("MfM_mom")) {
+    Set(MfM);
+  }
+  void Set(const Vec3& MfM, const Vec3& MfM_mom = Vec3(0, 0, 0)) {
     MfM_ = MfM;
+    MfM_mom_ = MfM_mom;
   }
   Vec3& MfM_;
+  Vec3& MfM_mom_;
 };
 
 }
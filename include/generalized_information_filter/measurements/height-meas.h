@@ -14,6 +14,9 @@ class HeightMeas : public ElementVector {
       : ElementVector(std::shared_ptr<ElementVectorDefinition>(
             new ElementPack<double>({"z"}))),
         z_(ElementVector::GetValue<double>("z")) {
+    Set(z);
+  }
+  void Set(const double& z) {
     z_ = z;
   }
   double& z_;
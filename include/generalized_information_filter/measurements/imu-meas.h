@@ -15,6 +15,9 @@ class ImuMeas : public ElementVector {
             new ElementPack<Vec3, Vec3>({"MwM", "MfM"}))),
         MwM_(ElementVector::GetValue<Vec3>("MwM")),
         MfM_(ElementVector::GetValue<Vec3>("MfM")) {
+    Set(MwM, MfM);
+  }
+  void Set(const Vec3& MwM, const Vec3& MfM) {
     MwM_ = MwM;
     MfM_ = MfM;
   }
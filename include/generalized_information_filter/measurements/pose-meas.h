@@ -15,6 +15,9 @@ class PoseMeas : public ElementVector {
             new ElementPack<Vec3, Quat>({ "JrJC", "qJC" }))),
         JrJC_(ElementVector::GetValue<Vec3>("JrJC")),
         qJC_(ElementVector::GetValue<Quat>("qJC")) {
+    Set(JrJC, qJC);
+  }
+  void Set(const Vec3& JrJC, const Quat& qJC) {
     JrJC_ = JrJC;
     qJC_ = qJC;
   }
@@ -14,6 +14,9 @@ class RorMeas : public ElementVector {
       : ElementVector(std::shared_ptr<ElementVectorDefinition>(
             new ElementPack<Vec3, Vec3>({"MwM"}))),
         MwM_(ElementVector::GetValue<Vec3>("MwM")) {
+    Set(MwM);
+  }
+  void Set(const Vec3& MwM) {
     MwM_ = MwM;
   }
   Vec3& MwM_;
@@ -55,6 +55,23 @@ class Model {
                           const std::array<const ElementVectorBase*,N_>& ins,
                           Ps&... elements) const;
 
+  template<typename... Ps, typename std::enable_if<(sizeof...(Ps)<OutPack::n_)>::type* = nullptr>
+  inline bool EvalJacWrapper(ElementVectorBase* out, const std::array<MatX*,N_>& J,
+                             const std::array<const ElementVectorBase*,N_>& ins,
+                             Ps&... elements) const;
+
+  template<typename... Ps, typename std::enable_if<(sizeof...(Ps) >= OutPack::n_
+               & sizeof...(Ps) <  OutPack::n_ + TH_pack_size<InPacks...>::n_)>::type* = nullptr>
+  inline bool EvalJacWrapper(ElementVectorBase* out, const std::array<MatX*,N_>& J,
+                             const std::array<const ElementVectorBase*,N_>& ins,
+                             Ps&... elements) const;
+
+  template<typename... Ps, typename std::enable_if<(sizeof...(Ps) == TH_pack_size<InPacks...>::n_
+                                                   +OutPack::n_)>::type* = nullptr>
+  inline bool EvalJacWrapper(ElementVectorBase* out, const std::array<MatX*,N_>& J,
+                             const std::array<const ElementVectorBase*,N_>& ins,
+                             Ps&... elements) const;
+
   template<int InIndex, typename... Ps, typename std::enable_if<
       (sizeof...(Ps)<TH_pack_size<InPacks...>::n_)>::type* = nullptr>
   inline void JacWrapper(MatX& J, const std::array<const ElementVectorBase*,N_>& ins,
@@ -143,6 +160,48 @@ inline void Model<Derived,OutPack,InPacks...>::EvalWrapper(
   static_cast<const Derived&>(*this).Eval(elements...);
 }
 
+template<typename Derived, typename OutPack, typename ... InPacks>
+template<typename... Ps, typename std::enable_if<(sizeof...(Ps)<OutPack::n_)>::type*>
+inline bool Model<Derived,OutPack,InPacks...>::EvalJacWrapper(
+      ElementVectorBase* out, const std::array<MatX*,N_>& J,
+      const std::array<const ElementVectorBase*,N_>& ins,
+      Ps&... elements) const{
+  DLOG_IF(FATAL, !out->MatchesDefinition(*outDefinition_)) <<
+      "Element vector definition mismatch";
+  static constexpr int inner_index = sizeof...(Ps);
+  typedef typename OutPack::Tuple Tuple;
+  typedef typename std::tuple_element<inner_index,Tuple>::type ElementType;
+  return EvalJacWrapper(out, J, ins, elements..., out->template GetValue<ElementType>(inner_index));
+}
+
+template<typename Derived, typename OutPack, typename ... InPacks>
+template<typename... Ps,typename std::enable_if<
+    (sizeof...(Ps) >= OutPack::n_ & sizeof...(Ps)<OutPack::n_+TH_pack_size<InPacks...>::n_)>::type*>
+inline bool Model<Derived,OutPack,InPacks...>::EvalJacWrapper(
+      ElementVectorBase* out, const std::array<MatX*,N_>& J,
+      const std::array<const ElementVectorBase*,N_>& ins,
+      Ps&... elements) const{
+  static constexpr int outerIndex = TH_pack_index<sizeof...(Ps)-n_,InPacks...>::GetOuter();
+  static constexpr int innerIndex = TH_pack_index<sizeof...(Ps)-n_,InPacks...>::GetInner();
+  static_assert(outerIndex < N_, "Indexing Error");
+  DLOG_IF(FATAL, !ins.at(outerIndex)->MatchesDefinition(*inDefinitions_[outerIndex])) <<
+      "Element vector definition mismatch";
+  typedef typename InPack<outerIndex>::Tuple Tuple;
+  typedef typename std::tuple_element<innerIndex,Tuple>::type ElementType;
+  return EvalJacWrapper(out, J, ins, elements...,
+                        ins.at(outerIndex)->template GetValue<ElementType>(innerIndex));
+}
+
+template<typename Derived, typename OutPack, typename ... InPacks>
+template<typename... Ps, typename std::enable_if<
+    (sizeof...(Ps)==TH_pack_size<InPacks...>::n_+OutPack::n_)>::type*>
+inline bool Model<Derived,OutPack,InPacks...>::EvalJacWrapper(
+      ElementVectorBase* out, const std::array<MatX*,N_>& J,
+      const std::array<const ElementVectorBase*,N_>& ins,
+      Ps&... elements) const{
+  return static_cast<const Derived&>(*this).EvalJac(J, elements...);
+}
+
 template<typename Derived, typename OutPack, typename ... InPacks>
 template<int InIndex, typename... Ps, typename std::enable_if<
     (sizeof...(Ps)<TH_pack_size<InPacks...>::n_)>::type*>
@@ -25,6 +25,7 @@ class Prediction<ElementPack<Sta...>, ElementPack<Noi...>, Meas> :
              const std::array<std::string, ElementPack<Noi...>::n_>& namesNoi)
       : mtBinaryRedidual(name, namesSta, namesSta, namesSta, namesNoi, false, true, true),
         prediction_(this->CurDefinition()) {
+    predictionVersion_ = 0;
   }
 
   virtual ~Prediction() {}
@@ -55,27 +56,48 @@ class Prediction<ElementPack<Sta...>, ElementPack<Noi...>, Meas> :
     Predict(elements..., pre..., noi...);
   }
 
+  // Computes the prediction, unless it is still valid for the current input version
+  inline void UpdatePrediction(const Sta&... pre, const Noi&... noi) const {
+    if (this->inputVersion_ == 0 || this->inputVersion_ != predictionVersion_) {
+      PredictWrapper(&prediction_, pre..., noi...);
+      predictionVersion_ = this->inputVersion_;
+    }
+  }
+
   // Wrapping from BinaryResidual to Prediction implementation
   inline void Eval(Vec<ElementTraits<Sta>::kDim>&... inn,
                    const Sta&... pre, const Sta&... cur, const Noi&... noi) const {
     // First compute prediction
-    PredictWrapper(&prediction_, pre..., noi...);
+    UpdatePrediction(pre..., noi...);
     // Then evaluate difference to posterior (inn = prediction - cur)
     ComputeInnovation(inn...,cur...,&prediction_);
   }
+  inline bool EvalWithJacobians(MatX& JPre, MatX& JCur, MatX& JNoi,
+                                Vec<ElementTraits<Sta>::kDim>&... inn,
+                                const Sta&... pre, const Sta&... cur, const Noi&... noi) const {
+    UpdatePrediction(pre..., noi...);
+    ComputeInnovation(inn...,cur...,&prediction_);
+    PredictJacPre(JPre,pre...,noi...);
+    ComputePreJacobian(JPre,&prediction_,cur...);
+    JCur.setZero();
+    ComputeCurJacobian(JCur,&prediction_,cur...);
+    PredictJacNoi(JNoi,pre...,noi...);
+    ComputeNoiJacobian(JNoi,&prediction_,cur...);
+    return true;
+  }
   inline void JacPre(MatX& J, const Sta&... pre, const Sta&... cur, const Noi&... noi) const {
     PredictJacPre(J,pre...,noi...);
-    PredictWrapper(&prediction_, pre..., noi...); // TODO: cash or avoid
+    UpdatePrediction(pre..., noi...);
     ComputePreJacobian(J,&prediction_,cur...);
   }
   inline void JacCur(MatX& J, const Sta&... pre, const Sta&... cur, const Noi&... noi) const {
     J.setZero();
-    PredictWrapper(&prediction_, pre..., noi...); // TODO: cash or avoid
+    UpdatePrediction(pre..., noi...);
     ComputeCurJacobian(J,&prediction_,cur...);
   }
   inline void JacNoi(MatX& J, const Sta&... pre, const Sta&... cur, const Noi&... noi) const {
     PredictJacNoi(J,pre...,noi...);
-    PredictWrapper(&prediction_, pre..., noi...); // TODO: cash or avoid
+    UpdatePrediction(pre..., noi...);
     ComputeNoiJacobian(J,&prediction_,cur...);
   }
 
@@ -148,6 +170,7 @@ class Prediction<ElementPack<Sta...>, ElementPack<Noi...>, Meas> :
 
  protected:
   mutable ElementVector prediction_;
+  mutable unsigned long predictionVersion_;  // Input version of prediction_
 };
 
 }
@@ -19,14 +19,15 @@ namespace GIF {
  *           J: Pose measurement reference inertial frame
  *           I: Estimation reference inertial frame
  */
-class HeightUpdate : public UnaryUpdate<ElementPack<double>,
-    ElementPack<double,Vec3>, ElementPack<double>, HeightMeas> {
+class HeightUpdate : public FixedSizeJacobians<UnaryUpdate<ElementPack<double>,
+    ElementPack<double,Vec3>, ElementPack<double>, HeightMeas>> {
  public:
   HeightUpdate(const std::string& name,
              const std::array<std::string,1>& errorName = {"z"},
              const std::array<std::string,2>& stateName = {"zRef", "IrIB"},
              const std::array<std::string,1>& noiseName = {"z"})
-       : mtUnaryUpdate(name, errorName, stateName, noiseName){
+       : mtFixedSizeJacobians(name, errorName, stateName, noiseName){
+    noiseStructure_ = NOISE_DIAGONAL;
   }
 
   virtual ~HeightUpdate() {
@@ -36,13 +37,20 @@ class HeightUpdate : public UnaryUpdate<ElementPack<double>,
     z_inn = IrIB_cur(2) - zRef_cur + z_noi - meas_->z_;
   }
 
-  void JacCur(MatX& J, const double& zRef_cur, const Vec3& IrIB_cur, const double& z_noi) const {
+  void JacPre(JacPreMat& J, const double& zRef_cur, const Vec3& IrIB_cur,
+              const double& z_noi) const {
+    J.setZero();
+  }
+
+  void JacCur(JacCurMat& J, const double& zRef_cur, const Vec3& IrIB_cur,
+              const double& z_noi) const {
     J.setZero();
     GetJacBlockCur<HEI, HEI>(J) = -Mat<1>::Identity();
     GetJacBlockCur<HEI, POS>(J) = Vec3(0,0,1).transpose();
   }
 
-  void JacNoi(MatX& J, const double& zRef_cur, const Vec3& IrIB_cur, const double& z_noi) const {
+  void JacNoi(JacNoiMat& J, const double& zRef_cur, const Vec3& IrIB_cur,
+              const double& z_noi) const {
     J.setZero();
     GetJacBlockNoi<HEI, HEI>(J) = Mat<1>::Identity();
   }
@@ -62,6 +62,7 @@ class PoseUpdate : public UnaryUpdate<ElementPack<Vec3, Quat>,
     useAttitude_ = true;
     usePosition_ = true;
     huberTh_ = -1.0;
+    this->noiseStructure_ = BinaryResidualBase::NOISE_DIAGONAL;
   }
 
   virtual ~PoseUpdate() {
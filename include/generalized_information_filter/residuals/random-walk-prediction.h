@@ -27,6 +27,8 @@ class RandomWalkPrediction<ElementPack<Sta...>>: public Prediction<ElementPack<S
   using mtPrediction::dt_;
   RandomWalkPrediction(const std::string& name, const StringArr& staName, const StringArr& noiName)
       : mtPrediction(name, staName, noiName){
+    this->noiseStructure_ = BinaryResidualBase::NOISE_DIAGONAL;
+    this->isRandomWalk_ = true;
   }
   virtual ~RandomWalkPrediction() {
   }
@@ -33,16 +33,17 @@ class AttitudeFindif
   void JacPre(MatX& J, const Quat& qIM_pre, const Vec3& MwM_pre,
               const Quat& qIM_cur, const Vec3& qIM_noi) const {
     J.setZero();
-    Quat dQ = dQ.exponentialMap(dt_ * MwM_pre);
+    const Vec3 dv = dt_ * MwM_pre + qIM_noi * sqrt(dt_);
+    Quat dQ = dQ.exponentialMap(dv);
     Vec3 qIM_inn = (qIM_pre * dQ).boxMinus(qIM_cur);
     this->template GetJacBlockPre<ATT, ATT>(J) = GammaMat(qIM_inn).inverse();
     this->template GetJacBlockPre<ATT, ROR>(J) = dt_ * GammaMat(qIM_inn).inverse() *
-        RotMat(qIM_pre).matrix() * GammaMat(dt_ * MwM_pre);
+        RotMat(qIM_pre).matrix() * GammaMat(dv);
   }
   void JacCur(MatX& J, const Quat& qIM_pre, const Vec3& MwM_pre,
               const Quat& qIM_cur, const Vec3& qIM_noi) const {
     J.setZero();
-    Quat dQ = dQ.exponentialMap(dt_ * MwM_pre);
+    Quat dQ = dQ.exponentialMap(dt_ * MwM_pre + qIM_noi * sqrt(dt_));
     Vec3 qIM_inn = (qIM_pre * dQ).boxMinus(qIM_cur);
     this->template GetJacBlockCur<ATT, ATT>(J) = -GammaMat(qIM_inn).inverse() *
         RotMat(qIM_pre * dQ * qIM_cur.inverted()).matrix();
@@ -50,10 +51,31 @@ class AttitudeFindif
   void JacNoi(MatX& J, const Quat& qIM_pre, const Vec3& MwM_pre,
               const Quat& qIM_cur, const Vec3& qIM_noi) const {
     J.setZero();
-    Quat dQ = dQ.exponentialMap(dt_ * MwM_pre);
+    const Vec3 dv = dt_ * MwM_pre + qIM_noi * sqrt(dt_);
+    Quat dQ = dQ.exponentialMap(dv);
     Vec3 qIM_inn = (qIM_pre * dQ).boxMinus(qIM_cur);
     this->template GetJacBlockNoi<ATT, ATT>(J) = sqrt(dt_) * GammaMat(qIM_inn).inverse() *
-        RotMat(qIM_pre).matrix() * GammaMat(dt_ * MwM_pre);
+        RotMat(qIM_pre).matrix() * GammaMat(dv);
+  }
+  // Shares the rotation increment, the predicted attitude and its difference between all outputs
+  bool EvalWithJacobians(MatX& JPre, MatX& JCur, MatX& JNoi, Vec3& qIM_inn,
+                         const Quat& qIM_pre, const Vec3& MwM_pre,
+                         const Quat& qIM_cur, const Vec3& qIM_noi) const {
+    const Vec3 dv = dt_ * MwM_pre + qIM_noi * sqrt(dt_);
+    Quat dQ = dQ.exponentialMap(dv);
+    const Quat qIM_pred = qIM_pre * dQ;
+    qIM_inn = qIM_pred.boxMinus(qIM_cur);
+    const Mat3 GammaInv = GammaMat(qIM_inn).inverse();
+    const Mat3 GammaInv_C_Gamma = GammaInv * RotMat(qIM_pre).matrix() * GammaMat(dv);
+    JPre.setZero();
+    this->template GetJacBlockPre<ATT, ATT>(JPre) = GammaInv;
+    this->template GetJacBlockPre<ATT, ROR>(JPre) = dt_ * GammaInv_C_Gamma;
+    JCur.setZero();
+    this->template GetJacBlockCur<ATT, ATT>(JCur) = -GammaInv *
+        RotMat(qIM_pred * qIM_cur.inverted()).matrix();
+    JNoi.setZero();
+    this->template GetJacBlockNoi<ATT, ATT>(JNoi) = sqrt(dt_) * GammaInv_C_Gamma;
+    return true;
   }
 };
 
@@ -8,6 +8,9 @@
 namespace GIF {
 
 /*! \brief Imu based robocentric acceleration finite difference residual
+ *         Merging preintegrates the accelerometer samples. Besides the mean specific force, the
+ *         first moment about the interval center is accumulated, it accounts for the rotation of the
+ *         body frame within the interval (first order in the rotational rate: MwM x MfM_mom).
  */
 class ImuaccFindif
       : public BinaryResidual<ElementPack<Vec3>, ElementPack<Vec3, Vec3, Vec3, Quat>,
@@ -32,7 +35,8 @@ class ImuaccFindif
   enum ElementsNoi {VEL_NOI};
   void Eval(Vec3& MvM_inn, const Vec3& MvM_pre, const Vec3& MwM_pre, const Vec3& MfM_bias_pre,
             const Quat& qIM_pre, const Vec3& MvM_cur, const Vec3& MvM_noi) const {
-    Vec3 MfM_cor = meas_->MfM_ - MfM_bias_pre + MvM_noi / sqrt(dt_);
+    Vec3 MfM_cor = meas_->MfM_ - MfM_bias_pre + MvM_noi / sqrt(dt_)
+                   - gSM(meas_->MfM_mom_) * MwM_pre;
     MvM_inn = (Mat3::Identity() - gSM(dt_ * MwM_pre)) * MvM_pre
               + dt_ * (MfM_cor + qIM_pre.inverseRotate(Ig_)) - MvM_cur;
   }
@@ -40,7 +44,7 @@ class ImuaccFindif
               const Quat& qIM_pre, const Vec3& MvM_cur, const Vec3& MvM_noi) const {
     J.setZero();
     this->template GetJacBlockPre<VEL_INN, VEL_PRE>(J) = (Mat3::Identity() - gSM(dt_ * MwM_pre));
-    this->template GetJacBlockPre<VEL_INN, ROR_PRE>(J) = dt_ * gSM(MvM_pre);
+    this->template GetJacBlockPre<VEL_INN, ROR_PRE>(J) = dt_ * gSM(MvM_pre - meas_->MfM_mom_);
     this->template GetJacBlockPre<VEL_INN, ACB_PRE>(J) = -dt_ * Mat3::Identity();
     this->template GetJacBlockPre<VEL_INN, ATT_PRE>(J) = dt_ * RotMat(qIM_pre).matrix().transpose()
         * gSM(Ig_);
@@ -55,6 +59,29 @@ class ImuaccFindif
     J.setZero();
     this->template GetJacBlockNoi<VEL_INN, VEL_NOI>(J) = sqrt(dt_) * Mat3::Identity();
   }
+  void MergeMeasurements(const TimePoint& t0, const TimePoint& t1, const TimePoint& t2,
+                         const ElementVectorBase::CPtr& in1,
+                         const ElementVectorBase::CPtr& in2,
+                         ElementVectorBase::CPtr& out) const {
+    const AccMeas& meas1 = static_cast<const AccMeas&>(*in1);
+    const AccMeas& meas2 = static_cast<const AccMeas&>(*in2);
+    std::shared_ptr<AccMeas> newMeas = MeasurementPool<AccMeas>::Get();
+    newMeas->Set(meas1.MfM_, meas1.MfM_mom_);
+    Concatenate(newMeas.get(), toSec(t1 - t0), meas2, toSec(t2 - t1));
+    out = newMeas;
+  }
+  void MergeMeasurementRun(const TimePoint& t0, const std::vector<TimePoint>& times,
+                           const std::vector<ElementVectorBase::CPtr>& in,
+                           ElementVectorBase::CPtr& out) const {
+    const AccMeas& first = static_cast<const AccMeas&>(*in.front());
+    std::shared_ptr<AccMeas> newMeas = MeasurementPool<AccMeas>::Get();
+    newMeas->Set(first.MfM_, first.MfM_mom_);
+    for (int j = 1; j < times.size(); j++) {
+      Concatenate(newMeas.get(), toSec(times[j - 1] - t0), static_cast<const AccMeas&>(*in[j]),
+                  toSec(times[j] - times[j - 1]));
+    }
+    out = newMeas;
+  }
   void SetHuberTh(double th){
     huberTh_ = th;
   }
@@ -73,6 +100,15 @@ class ImuaccFindif
   }
 
  protected:
+  // Appends the interval of meas (duration dtMeas) to the preintegrated one of acc (duration dtAcc),
+  // the centers of the two intervals lie at -dtMeas/2 and +dtAcc/2 of the joint center
+  static void Concatenate(AccMeas* acc, double dtAcc, const AccMeas& meas, double dtMeas) {
+    const double dt = dtAcc + dtMeas;
+    acc->MfM_mom_ = (dtAcc * acc->MfM_mom_ + dtMeas * meas.MfM_mom_
+                     - 0.5 * dtAcc * dtMeas * (acc->MfM_ - meas.MfM_)) / dt;
+    acc->MfM_ = (dtAcc * acc->MfM_ + dtMeas * meas.MfM_) / dt;
+  }
+
   const Vec3 Ig_;
   double huberTh_;
 };
@@ -8,6 +8,8 @@
 namespace GIF {
 
 /*! \brief Imu based robocentric rotational rate update
+ *         Merging preintegrates the gyroscope samples to a delta-rotation, the merged measurement
+ *         is the constant rate yielding the same rotation over the interval.
  */
 class ImurorUpdate : public BinaryResidual<ElementPack<Vec3>, ElementPack<>,
                                         ElementPack<Vec3,Vec3>, ElementPack<Vec3>, RorMeas> {
@@ -46,6 +48,31 @@ class ImurorUpdate : public BinaryResidual<ElementPack<Vec3>, ElementPack<>,
     J.setZero();
     this->template GetJacBlockNoi<ROR, ROR>(J) = -1/sqrt(dt_) * Mat3::Identity();
   }
+  void MergeMeasurements(const TimePoint& t0, const TimePoint& t1, const TimePoint& t2,
+                         const ElementVectorBase::CPtr& in1,
+                         const ElementVectorBase::CPtr& in2,
+                         ElementVectorBase::CPtr& out) const {
+    Quat dQ1 = dQ1.exponentialMap(toSec(t1 - t0) * static_cast<const RorMeas&>(*in1).MwM_);
+    Quat dQ2 = dQ2.exponentialMap(toSec(t2 - t1) * static_cast<const RorMeas&>(*in2).MwM_);
+    std::shared_ptr<RorMeas> newMeas = MeasurementPool<RorMeas>::Get();
+    newMeas->Set((dQ1 * dQ2).boxMinus(Quat()) / toSec(t2 - t0));
+    out = newMeas;
+  }
+  void MergeMeasurementRun(const TimePoint& t0, const std::vector<TimePoint>& times,
+                           const std::vector<ElementVectorBase::CPtr>& in,
+                           ElementVectorBase::CPtr& out) const {
+    Quat dQ;  // Accumulated delta-rotation
+    TimePoint previous = t0;
+    for (int j = 0; j < times.size(); j++) {
+      Quat dQj = dQj.exponentialMap(toSec(times[j] - previous)
+                                    * static_cast<const RorMeas&>(*in[j]).MwM_);
+      dQ = dQ * dQj;
+      previous = times[j];
+    }
+    std::shared_ptr<RorMeas> newMeas = MeasurementPool<RorMeas>::Get();
+    newMeas->Set(dQ.boxMinus(Quat()) / toSec(times.back() - t0));
+    out = newMeas;
+  }
   void SetHuberTh(double th){
     huberTh_ = th;
   }
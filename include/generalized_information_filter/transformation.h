@@ -52,6 +52,14 @@ class Transformation<ElementPack<Out...>, ElementPack<In...>> : public Model<
     outputCov = J_ * inputCov * J_.transpose();
   }
 
+  // Same as above but with the input covariance given as factorized information (no inversion)
+  void TransformCovMat(MatX& outputCov, const ElementVectorBase& in,
+                       const Eigen::LDLT<MatX>& inputInfLDLT) {
+    const std::array<const ElementVectorBase*, 1> ins = {&in};
+    this->template JacWrapper<0>(J_, ins);
+    outputCov = J_ * inputInfLDLT.solve(J_.transpose());
+  }
+
   template<int n, int m>
   MatRef<ElementPack<Out...>::template _GetStateDimension<n>(),
          ElementPack<In...>::template _GetStateDimension<m>()> GetJacBlock(MatRefX J) const {
@@ -3,8 +3,24 @@
 
 namespace GIF {
 
+int SymbolTable::GetSymbol(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto& entry = symbols_map_.insert(std::pair<std::string, int>(name, names_.size()));
+  if (entry.second) {
+    names_.push_back(&entry.first->first);
+  }
+  return entry.first->second;
+}
+
+const std::string& SymbolTable::GetName(int symbol) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return *names_.at(symbol);
+}
+
 ElementVectorDefinition::ElementVectorDefinition() {
   dim_ = 0;
+  value_size_ = 0;
+  is_plain_ = true;
 }
 
 ElementVectorDefinition::~ElementVectorDefinition() {}
@@ -13,12 +29,12 @@ bool ElementVectorDefinition::MatchesDefinition(const ElementVectorDefinition& o
   if (GetDim() != other.GetDim()) {
     return false;
   }
-  for (const auto& entry : names_map_) {
-    int other_outer_index = other.FindName(entry.first);
-    if (other_outer_index != entry.second) {
+  for (int i = 0; i < GetNumElements(); i++) {
+    int other_outer_index = other.FindSymbol(GetSymbol(i));
+    if (other_outer_index != i) {
       return false;
     }
-    if (!GetElementDescription(entry.second)->MatchesDescription(
+    if (!GetElementDescription(i)->MatchesDescription(
         other.GetElementDescription(other_outer_index))) {
       return false;
     }
@@ -31,14 +47,8 @@ bool ElementVectorDefinition::MatchesDefinition(
   return MatchesDefinition(*other.GetDefinition());
 }
 
-std::string ElementVectorDefinition::GetName(int outer_index) const { // Slow
-  for (const auto& e : names_map_) {
-    if (e.second == outer_index) {
-      return e.first;
-    }
-  }
-  LOG(ERROR) << "Index not found in name map";
-  return "";
+const std::string& ElementVectorDefinition::GetName(int outer_index) const {
+  return *names_.at(outer_index);
 }
 
 int ElementVectorDefinition::FindName(const std::string& name) const {
@@ -61,8 +71,34 @@ int ElementVectorDefinition::AddElement(const std::string& name,
     descriptions_.push_back(description);
     start_indices_.push_back(dim_);
     dim_ += description->GetDim();
-    names_map_.insert(std::pair<std::string, int>(name, GetNumElements() - 1));
-    return GetNumElements() - 1;
+    const int alignment = description->GetValueAlignment();
+    value_offsets_.push_back((value_size_ + alignment - 1) / alignment * alignment);
+    value_size_ = value_offsets_.back() + description->GetValueSize();
+    is_plain_ &= description->IsPlain();
+    outer_index = GetNumElements() - 1;
+    outer_indices_.resize(dim_, outer_index);
+    if (description->IsFlatVector()) {  // Extend last run if contiguous in value and tangent space
+      if (!vector_runs_.empty()
+          && vector_runs_.back().start_ + vector_runs_.back().dim_ == start_indices_.back()
+          && vector_runs_.back().value_offset_ + vector_runs_.back().dim_ * (int)sizeof(double)
+              == value_offsets_.back()) {
+        vector_runs_.back().dim_ += description->GetDim();
+      } else {
+        vector_runs_.push_back({value_offsets_.back(), start_indices_.back(), description->GetDim()});
+      }
+    } else if (description->GetTypeId() == ElementTypeId<Quat>::Get()) {
+      quat_indices_.push_back(outer_index);
+    } else {
+      other_indices_.push_back(outer_index);
+    }
+    names_map_.insert(std::pair<std::string, int>(name, outer_index));
+    symbols_.push_back(SymbolTable::Instance().GetSymbol(name));
+    names_.push_back(&SymbolTable::Instance().GetName(symbols_.back()));
+    if (symbols_.back() >= symbol_outer_.size()) {
+      symbol_outer_.resize(symbols_.back() + 1, -1);
+    }
+    symbol_outer_[symbols_.back()] = outer_index;
+    return outer_index;
   }
 }
 
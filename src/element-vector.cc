@@ -2,6 +2,8 @@
 
 namespace GIF {
 
+constexpr int ElementVectorBase::kQuatBatch;
+
 ElementVectorBase::ElementVectorBase(
       const ElementVectorDefinition::CPtr& def): def_(def) {
 }
@@ -53,7 +55,41 @@ void ElementVectorBase::SetRandom() {
 void ElementVectorBase::BoxPlus(const VecCRefX& vec, ElementVectorBase* out) const {
   DLOG_IF(FATAL, !MatchesDefinition(*out->GetDefinition()))
       << "Definition mismatch during element vector assignement";
-  for (int i = 0; i < GetNumElement(); i++) {
+  const char* data = GetData();
+  char* out_data = out->GetData();
+  if (data == nullptr || out_data == nullptr) {
+    for (int i = 0; i < GetNumElement(); i++) {
+      GetElement(i)->Boxplus(
+          vec.block(GetStart(i), 0, GetElement(i)->GetDim(), 1),
+          out->GetElement(i));
+    }
+    return;
+  }
+
+  // Batched version for contiguous storage (identical layout since definitions match)
+  const ElementVectorDefinition* def = GetDefinition();
+  for (const auto& run : def->GetVectorRuns()) {
+    Eigen::Map<VecX>(reinterpret_cast<double*>(out_data + run.value_offset_), run.dim_) =
+        Eigen::Map<const VecX>(reinterpret_cast<const double*>(data + run.value_offset_), run.dim_)
+        + vec.segment(run.start_, run.dim_);
+  }
+  const std::vector<int>& quat_indices = def->GetQuatIndices();
+  Eigen::Array<double, 3, kQuatBatch> rot_vec;
+  Eigen::Array<double, 4, kQuatBatch> dq;
+  for (int k = 0; k < quat_indices.size(); k += kQuatBatch) {
+    const int n = std::min<int>(kQuatBatch, quat_indices.size() - k);
+    rot_vec.setZero();
+    for (int j = 0; j < n; j++) {
+      rot_vec.col(j) = vec.segment<3>(GetStart(quat_indices[k + j]));
+    }
+    ElementTraits<Quat>::ExponentialMap(rot_vec, dq);
+    for (int j = 0; j < n; j++) {
+      const int offset = def->GetValueOffset(quat_indices[k + j]);
+      *reinterpret_cast<Quat*>(out_data + offset) = Quat(dq(0, j), dq(1, j), dq(2, j), dq(3, j))
+          * *reinterpret_cast<const Quat*>(data + offset);
+    }
+  }
+  for (int i : def->GetOtherIndices()) {
     GetElement(i)->Boxplus(
         vec.block(GetStart(i), 0, GetElement(i)->GetDim(), 1),
         out->GetElement(i));
@@ -64,7 +100,32 @@ void ElementVectorBase::BoxMinus(const ElementVectorBase& ref,
                          VecRefX vec) const {
   DLOG_IF(FATAL, !MatchesDefinition(*ref.GetDefinition()))
       << "Definition mismatch during element vector assignement";
-  for (int i = 0; i < GetNumElement(); i++) {
+  const char* data = GetData();
+  const char* ref_data = ref.GetData();
+  if (data == nullptr || ref_data == nullptr) {
+    for (int i = 0; i < GetNumElement(); i++) {
+      GetElement(i)->Boxminus(
+          *ref.GetElement(i),
+          vec.block(GetStart(i), 0, GetElement(i)->GetDim(), 1));
+    }
+    return;
+  }
+
+  // Batched version for contiguous storage (identical layout since definitions match)
+  const ElementVectorDefinition* def = GetDefinition();
+  for (const auto& run : def->GetVectorRuns()) {
+    vec.segment(run.start_, run.dim_) =
+        Eigen::Map<const VecX>(reinterpret_cast<const double*>(data + run.value_offset_), run.dim_)
+        - Eigen::Map<const VecX>(reinterpret_cast<const double*>(ref_data + run.value_offset_),
+                                 run.dim_);
+  }
+  for (int i : def->GetQuatIndices()) {
+    const int offset = def->GetValueOffset(i);
+    ElementTraits<Quat>::Boxminus(*reinterpret_cast<const Quat*>(data + offset),
+                                  *reinterpret_cast<const Quat*>(ref_data + offset),
+                                  vec.segment<3>(GetStart(i)));
+  }
+  for (int i : def->GetOtherIndices()) {
     GetElement(i)->Boxminus(
         *ref.GetElement(i),
         vec.block(GetStart(i), 0, GetElement(i)->GetDim(), 1));
@@ -75,11 +136,25 @@ const ElementVectorDefinition* ElementVectorBase::GetDefinition() const {
   return def_.get();
 }
 
+char* ElementVectorBase::GetData() {
+  return nullptr;
+}
+
+const char* ElementVectorBase::GetData() const {
+  return nullptr;
+}
+
 ElementVector::ElementVector(const ElementVectorDefinition::CPtr& def)
     : ElementVectorBase(def) {
   Construct();
 }
 
+ElementVector::ElementVector(const ElementVector& other)
+    : ElementVectorBase(other.def_) {
+  Construct();
+  *this = other;
+}
+
 ElementVector::~ElementVector() {
 }
 
@@ -89,13 +164,16 @@ ElementVector& ElementVector::operator=(const ElementVectorBase& other) {
 }
 
 ElementVector& ElementVector::operator=(const ElementVector& other) {
-  dynamic_cast<ElementVectorBase&>(*this) = other;
+  if (def_ == other.def_ && def_->IsPlain() && data_.size() == other.data_.size()) {
+    std::copy(other.data_.begin(), other.data_.end(), data_.begin());
+  } else {
+    dynamic_cast<ElementVectorBase&>(*this) = other;
+  }
   return *this;
 }
 
 ElementVector& ElementVector::operator=(ElementVector& other) {
-  dynamic_cast<ElementVectorBase&>(*this) = other;
-  return *this;
+  return *this = static_cast<const ElementVector&>(other);
 }
 
 int ElementVector::GetNumElement() const {
@@ -104,12 +182,22 @@ int ElementVector::GetNumElement() const {
 
 void ElementVector::Construct(){
   elements_.clear();
+  data_.assign(GetDefinition()->GetValueSize(), 0);
   for (int i = 0; i < GetDefinition()->GetNumElements(); i++) {
     const ElementDescriptionBase::CPtr& description = GetDefinition()->GetElementDescription(i);
-    elements_.push_back(description->MakeElement(description));
+    elements_.push_back(description->MakeElement(
+        description, data_.data() + GetDefinition()->GetValueOffset(i)));
   }
 }
 
+char* ElementVector::GetData() {
+  return data_.data();
+}
+
+const char* ElementVector::GetData() const {
+  return data_.data();
+}
+
 ElementVectorWrapper::ElementVectorWrapper(
       const ElementVectorDefinition::CPtr& def,
       const ElementVectorDefinition::CPtr& in): ElementVectorBase(def), inDef_(in),
@@ -132,9 +220,24 @@ int ElementVectorWrapper::GetNumElement() const {
 void ElementVectorWrapper::ComputeMap() {
   indexMap_.resize(GetDefinition()->GetNumElements());
   for (int i = 0; i < GetDefinition()->GetNumElements(); i++) {
-    indexMap_[i] = inDef_->FindName(GetName(i));
+    indexMap_[i] = inDef_->FindSymbol(GetDefinition()->GetSymbol(i));
     DLOG_IF(ERROR, indexMap_.at(i) == -1) << "Element name not found";
   }
+  scatterPlan_.clear();
+  for (int i = 0; i < GetDefinition()->GetNumElements(); i++) {
+    if (indexMap_.at(i) == -1) {
+      continue;
+    }
+    const int src = GetStart(i);
+    const int dst = inDef_->GetStart(indexMap_.at(i));
+    const int width = GetDefinition()->GetElementDescription(i)->GetDim();
+    if (!scatterPlan_.empty() && scatterPlan_.back().src_ + scatterPlan_.back().width_ == src
+        && scatterPlan_.back().dst_ + scatterPlan_.back().width_ == dst) {
+      scatterPlan_.back().width_ += width;
+    } else if (width > 0) {
+      scatterPlan_.push_back({src, dst, width});
+    }
+  }
 }
 
 void ElementVectorWrapper::SetElementVector(ElementVectorBase* element_vector) {
@@ -154,10 +257,8 @@ void ElementVectorWrapper::EmbedJacobian(MatRef<> out,
                                         const MatCRef<>& in,
                                         int rowOffset) const {
   const int rows = in.rows();
-  for (int i = 0; i < GetNumElement(); ++i) {
-    const int cols = GetElement(i)->GetDim();
-    out.block(rowOffset, const_element_vector_->GetStart(indexMap_.at(i)), rows, cols) =
-        in.block(0, GetStart(i), rows, cols);
+  for (const auto& run : scatterPlan_) {
+    out.block(rowOffset, run.dst_, rows, run.width_) = in.block(0, run.src_, rows, run.width_);
   }
 }
 
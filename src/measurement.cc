@@ -3,6 +3,162 @@
 
 namespace GIF {
 
+namespace {
+int NextPowerOfTwo(int n) {
+  int p = 1;
+  while (p < n) {
+    p <<= 1;
+  }
+  return p;
+}
+}
+
+MeasurementBuffer::MeasurementBuffer(int capacity)
+    : entries_(NextPowerOfTwo(capacity)), mask_(entries_.size() - 1), head_(0), size_(0) {
+}
+
+MeasurementBuffer::~MeasurementBuffer() {
+}
+
+void MeasurementBuffer::PushBack(const TimePoint& t, const ElementVectorBase::CPtr& meas) {
+  DLOG_IF(ERROR, size_ > 0 && t <= Back().t_) << "Non-chronological push back";
+  if (size_ == static_cast<int>(entries_.size())) {
+    Grow();
+  }
+  Entry& entry = At(size_);
+  entry.t_ = t;
+  entry.meas_ = meas;
+  size_++;
+}
+
+void MeasurementBuffer::PopFront() {
+  DLOG_IF(FATAL, size_ == 0) << "Popping from empty measurement buffer";
+  Front().meas_.reset();
+  head_ = (head_ + 1) & mask_;
+  size_--;
+}
+
+void MeasurementBuffer::Insert(int k, const TimePoint& t, const ElementVectorBase::CPtr& meas) {
+  if (size_ == static_cast<int>(entries_.size())) {
+    Grow();
+  }
+  for (int j = size_; j > k; j--) {
+    At(j) = std::move(At(j - 1));
+  }
+  At(k).t_ = t;
+  At(k).meas_ = meas;
+  size_++;
+}
+
+void MeasurementBuffer::Erase(int k) {
+  // Shift the shorter side
+  if (k < size_ / 2) {
+    for (int j = k; j > 0; j--) {
+      At(j) = std::move(At(j - 1));
+    }
+    PopFront();
+  } else {
+    for (int j = k; j < size_ - 1; j++) {
+      At(j) = std::move(At(j + 1));
+    }
+    Back().meas_.reset();
+    size_--;
+  }
+}
+
+void MeasurementBuffer::Replace(int begin, int end, const std::vector<Entry>& entries) {
+  const int diff = static_cast<int>(entries.size()) - (end - begin);
+  while (size_ + diff > static_cast<int>(entries_.size())) {
+    Grow();
+  }
+  for (int k = begin; k < end; k++) {
+    At(k).meas_.reset();
+  }
+  // Shift the shorter side
+  if (begin < size_ - end) {
+    if (diff > 0) {
+      for (int k = 0; k < begin; k++) {
+        At(k - diff) = std::move(At(k));
+      }
+    } else {
+      for (int k = begin - 1; k >= 0; k--) {
+        At(k - diff) = std::move(At(k));
+      }
+    }
+    head_ = (head_ - diff) & mask_;
+  } else {
+    if (diff > 0) {
+      for (int k = size_ - 1; k >= end; k--) {
+        At(k + diff) = std::move(At(k));
+      }
+    } else {
+      for (int k = end; k < size_; k++) {
+        At(k + diff) = std::move(At(k));
+      }
+    }
+  }
+  size_ += diff;
+  for (int k = 0; k < entries.size(); k++) {
+    At(begin + k) = entries[k];
+  }
+}
+
+void MeasurementBuffer::Clear() {
+  while (size_ > 0) {
+    PopFront();
+  }
+  head_ = 0;
+}
+
+int MeasurementBuffer::LowerBound(const TimePoint& t) const {
+  int first = 0;
+  int count = size_;
+  while (count > 0) {
+    const int step = count / 2;
+    if (At(first + step).t_ < t) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+int MeasurementBuffer::UpperBound(const TimePoint& t) const {
+  int first = 0;
+  int count = size_;
+  while (count > 0) {
+    const int step = count / 2;
+    if (!(t < At(first + step).t_)) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+int MeasurementBuffer::Find(const TimePoint& t) const {
+  // Most lookups target the oldest measurements
+  if (size_ > 0 && Front().t_ == t) {
+    return 0;
+  }
+  const int k = LowerBound(t);
+  return (k < size_ && At(k).t_ == t) ? k : -1;
+}
+
+void MeasurementBuffer::Grow() {
+  std::vector<Entry> entries(2 * entries_.size());
+  for (int k = 0; k < size_; k++) {
+    entries[k] = std::move(At(k));
+  }
+  entries_.swap(entries);
+  mask_ = entries_.size() - 1;
+  head_ = 0;
+}
+
 MeasurementTimeline::MeasurementTimeline(const bool drop_first,
                                          const Duration& max_wait_time,
                                          const Duration& min_wait_time) {
@@ -15,68 +171,76 @@ MeasurementTimeline::MeasurementTimeline(const bool drop_first,
 MeasurementTimeline::~MeasurementTimeline() {
 }
 
-void MeasurementTimeline::AddMeasurement(const ElementVectorBase::CPtr& meas,
+bool MeasurementTimeline::AddMeasurement(const ElementVectorBase::CPtr& meas,
                                   const TimePoint& t) {
   // Discard first measurement in binary case
   if (drop_first_ && last_processed_time_ == TimePoint::min()) {
-    LOG(INFO) << "Droping first measurement" << std::endl;
+    GIF_TRACE(2) << "Droping first measurement" << std::endl;
     last_processed_time_ = t;
-    return;
+    return false;
   }
   if (t <= last_processed_time_) {
     LOG(ERROR) << "Adding measurements before last processed time (will be discarded)" << std::endl;
+    return false;
+  } else if (meas_.Empty() || meas_.Back().t_ < t) {
+    // Common chronological case
+    meas_.PushBack(t, meas);
+    GIF_TRACE(2) << "Adding measurement" << std::endl;
+    return true;
   } else {
-    std::pair<std::map<TimePoint, ElementVectorBase::CPtr>::iterator, bool> ret;
-    ret = meas_map_.insert(std::pair<TimePoint, ElementVectorBase::CPtr>(t, meas));
-    if (!ret.second) {
+    const int k = meas_.LowerBound(t);
+    if (meas_.At(k).t_ == t) {
       LOG(ERROR) << "Measurement already exists!" << std::endl;
+      return false;
     } else {
-      LOG(INFO) << "Adding measurement" << std::endl;
+      meas_.Insert(k, t, meas);
+      GIF_TRACE(2) << "Adding measurement" << std::endl;
+      return true;
     }
   }
 }
 
 bool MeasurementTimeline::GetMeasurement(const TimePoint& t,
                                   ElementVectorBase::CPtr& meas) {
-  auto it = meas_map_.find(t);
-  if (it == meas_map_.end()) {
+  const int k = meas_.Find(t);
+  if (k == -1) {
     return false;
   } else {
-    meas = it->second;
+    meas = meas_.At(k).meas_;
     return true;
   }
 }
 
 void MeasurementTimeline::RemoveProcessedFirst() {
-  LOG_IF(ERROR,meas_map_.size() == 0) << "No measurement to remove";
-  last_processed_time_ = meas_map_.begin()->first;
-  meas_map_.erase(meas_map_.begin());
+  LOG_IF(ERROR,meas_.Empty()) << "No measurement to remove";
+  last_processed_time_ = meas_.Front().t_;
+  meas_.PopFront();
 }
 
 void MeasurementTimeline::Reset() {
-  meas_map_.clear();
+  meas_.Clear();
   last_processed_time_ = TimePoint::min();
 }
 
 TimePoint MeasurementTimeline::GetLastTime() const {
-  if (!meas_map_.empty()) {
-    return meas_map_.rbegin()->first;
+  if (!meas_.Empty()) {
+    return meas_.Back().t_;
   } else {
     return last_processed_time_;
   }
 }
 
 TimePoint MeasurementTimeline::GetFirstTime() const {
-  if (!meas_map_.empty()) {
-    return meas_map_.begin()->first;
+  if (!meas_.Empty()) {
+    return meas_.Front().t_;
   } else {
     return TimePoint::max();
   }
 }
 
 bool MeasurementTimeline::GetFirst(ElementVectorBase::CPtr& meas) {
-  if (!meas_map_.empty()) {
-    meas = meas_map_.begin()->second;
+  if (!meas_.Empty()) {
+    meas = meas_.Front().meas_;
     return true;
   } else {
     return false;
@@ -85,100 +249,163 @@ bool MeasurementTimeline::GetFirst(ElementVectorBase::CPtr& meas) {
 
 TimePoint MeasurementTimeline::GetMaximalUpdateTime(const TimePoint& current_time) const {
   TimePoint maximalUpdateTime = current_time - max_wait_time_;
-  if (!meas_map_.empty()) {
-    maximalUpdateTime = std::max(maximalUpdateTime, meas_map_.rbegin()->first + min_wait_time_);
+  if (!meas_.Empty()) {
+    maximalUpdateTime = std::max(maximalUpdateTime, meas_.Back().t_ + min_wait_time_);
   } else {
     maximalUpdateTime = std::max(maximalUpdateTime, last_processed_time_ + min_wait_time_);
   }
   return maximalUpdateTime;
 }
 
-void MeasurementTimeline::GetAllInRange(std::set<TimePoint>& times,
+void MeasurementTimeline::GetAllInRange(std::vector<TimePoint>& times,
                                         const TimePoint& start,
                                         const TimePoint& end) const {
-  auto it = meas_map_.upper_bound(start);
-  while (it != meas_map_.end() && it->first <= end) {
-    times.insert(it->first);
-    ++it;
+  for (int k = meas_.UpperBound(start); k < meas_.Size() && meas_.At(k).t_ <= end; k++) {
+    times.push_back(meas_.At(k).t_);
   }
 }
 
-void MeasurementTimeline::GetLastInRange(std::set<TimePoint>& times,
+void MeasurementTimeline::GetLastInRange(std::vector<TimePoint>& times,
                                          const TimePoint& start,
                                          const TimePoint& end) const {
-  auto it = meas_map_.upper_bound(end);
-  if (it != meas_map_.begin()) {
-    --it;
-    if (it->first > start) {
-      times.insert(it->first);
-    }
+  const int k = meas_.UpperBound(end);
+  if (k > 0 && meas_.At(k - 1).t_ > start) {
+    times.push_back(meas_.At(k - 1).t_);
   }
 }
 
 void MeasurementTimeline::Split(const TimePoint& t0, const TimePoint& t1, const TimePoint& t2,
                                 const BinaryResidualBase* res) {
   DLOG_IF(ERROR,t0 > t1 || t1 > t2) << "No chronological times";
-  LOG(INFO) << "Insert measurement in " << res->name_
-            << " at " << GIF::Print(t1);
-  AddMeasurement(ElementVectorBase::CPtr(), t1);
-  res->SplitMeasurements(t0, t1, t2, meas_map_.at(t2), meas_map_.at(t1), meas_map_.at(t2));
-}
-
-void MeasurementTimeline::Split(const std::set<TimePoint>& times, const BinaryResidualBase* res) {
-  for (const auto& t : times) {
-    auto it = meas_map_.lower_bound(t);
-    if (it == meas_map_.end()) {
-      LOG(ERROR) << "Range error while splitting while searching lower bound for "
-                 << GIF::Print(t) << "! (" << res->name_ << ")" << std::endl;
-      continue;
+  GIF_TRACE(2) << "Insert measurement in " << res->name_
+               << " at " << GIF::Print(t1);
+  const int k = meas_.LowerBound(t1);
+  meas_.Insert(k, t1, ElementVectorBase::CPtr());
+  res->SplitMeasurements(t0, t1, t2, meas_.At(k + 1).meas_, meas_.At(k).meas_,
+                         meas_.At(k + 1).meas_);
+}
+
+void MeasurementTimeline::Split(const std::vector<TimePoint>& times,
+                                const BinaryResidualBase* res) {
+  // Single pass merge-join of the times with the timeline, each measurement is split at all times
+  // it covers at once. Only the range from the first to the last split measurement is rebuilt.
+  auto it = times.begin();
+  TimePoint previous = last_processed_time_;
+  int first = -1;
+  int end = -1;
+  int scratchEnd = 0;
+  for (int k = 0; k < meas_.Size() && it != times.end(); k++) {
+    const MeasurementBuffer::Entry& entry = meas_.At(k);
+    runTimes_.clear();
+    for (; it != times.end() && *it <= entry.t_; ++it) {
+      if (*it < entry.t_) {
+        runTimes_.push_back(*it);
+      }
     }
-    if (it->first == t) {
-      // Measurement already available
-      continue;
+    if (!runTimes_.empty()) {
+      GIF_TRACE(2) << "Insert " << runTimes_.size() << " measurements in " << res->name_
+                   << " before " << GIF::Print(entry.t_);
+      if (first == -1) {
+        first = k;
+      }
+      runTimes_.push_back(entry.t_);
+      res->SplitMeasurementRun(previous, runTimes_, entry.meas_, runMeas_);
+      for (int j = 0; j < runTimes_.size(); j++) {
+        scratch_.push_back({runTimes_[j], runMeas_[j]});
+      }
+      end = k + 1;
+      scratchEnd = scratch_.size();
+    } else if (first != -1) {
+      scratch_.push_back(entry);
     }
-    TimePoint previous = (it == meas_map_.begin()) ? last_processed_time_ : std::prev(it)->first;
-    Split(previous, t, it->first, res);
+    previous = entry.t_;
+  }
+  for (; it != times.end(); ++it) {
+    LOG(ERROR) << "Range error while splitting while searching lower bound for "
+               << GIF::Print(*it) << "! (" << res->name_ << ")" << std::endl;
+  }
+  if (first != -1) {
+    scratch_.resize(scratchEnd);  // Trailing unsplit measurements need no copy
+    meas_.Replace(first, end, scratch_);
   }
+  scratch_.clear();
+  runMeas_.clear();
 }
 
 void MeasurementTimeline::Merge(const TimePoint& t0, const TimePoint& t1, const TimePoint& t2,
                                 const BinaryResidualBase* res) {
   DLOG_IF(ERROR,t0 > t1 || t1 > t2) << "No chronological times";
-  LOG(INFO) << "Merging measurement in " << res->name_
-            << ", removed at " << GIF::Print(t1);
-  res->MergeMeasurements(t0, t1, t2, meas_map_.at(t1), meas_map_.at(t2), meas_map_.at(t2));
-  meas_map_.erase(t1);  // does not count as processed
+  GIF_TRACE(2) << "Merging measurement in " << res->name_
+               << ", removed at " << GIF::Print(t1);
+  const int k = meas_.Find(t1);
+  DLOG_IF(FATAL, k == -1 || k + 1 == meas_.Size()) << "Merge times not in timeline";
+  res->MergeMeasurements(t0, t1, t2, meas_.At(k).meas_, meas_.At(k + 1).meas_,
+                         meas_.At(k + 1).meas_);
+  meas_.Erase(k);  // does not count as processed
 }
 
-void MeasurementTimeline::MergeUndesired(const std::set<TimePoint>& times,
+void MeasurementTimeline::MergeUndesired(const std::vector<TimePoint>& times,
                                          const BinaryResidualBase* res) {
   // Merge measurements such that only timepoints remain which are in times or
-  // past its end.
-  if (times.size() == 0) {
+  // past its end. Single pass merge-join of the times with the timeline, each run of undesired
+  // measurements is merged at once into the measurement following it.
+  if (times.empty()) {
     return;
   }
-  for (auto it = meas_map_.begin(); it != meas_map_.end();) {
-    if (it->first > *times.rbegin()) {
-      break;
-    }
-    if (times.count(it->first) > 0) {
-      ++it;
-      continue;
+  const TimePoint& last = times.back();
+  auto it = times.begin();
+  TimePoint previous = last_processed_time_;
+  int first = -1;
+  int k = 0;
+  while (k < meas_.Size() && meas_.At(k).t_ <= last) {
+    // Find the end of the run of undesired measurements starting at k
+    int end = k;
+    for (; end < meas_.Size() && meas_.At(end).t_ <= last; end++) {
+      for (; *it < meas_.At(end).t_; ++it) {}  // Terminates since the time is at most last
+      if (*it == meas_.At(end).t_) {
+        break;
+      }
     }
-    if (next(it) == meas_map_.end()) {
+    bool rangeError = false;
+    if (end == meas_.Size()) {
       LOG(ERROR) << "Range error while merging!" << std::endl;
+      rangeError = true;
+      end--;
+    }
+    if (end > k) {
+      GIF_TRACE(2) << "Merging " << end - k << " measurements in " << res->name_
+                   << " into " << GIF::Print(meas_.At(end).t_);
+      if (first == -1) {
+        first = k;
+      }
+      runTimes_.clear();
+      runMeas_.clear();
+      for (int j = k; j <= end; j++) {
+        runTimes_.push_back(meas_.At(j).t_);
+        runMeas_.push_back(meas_.At(j).meas_);
+      }
+      scratch_.push_back({meas_.At(end).t_, ElementVectorBase::CPtr()});
+      res->MergeMeasurementRun(previous, runTimes_, runMeas_, scratch_.back().meas_);
+    } else if (first != -1) {
+      scratch_.push_back(meas_.At(end));
+    }
+    previous = meas_.At(end).t_;
+    k = end + 1;
+    if (rangeError) {
       break;
     }
-    TimePoint previous = (it == meas_map_.begin()) ? last_processed_time_ : std::prev(it)->first;
-    ++it;  // Needs to be increment before erase
-    Merge(previous, std::prev(it)->first, it->first, res);
   }
+  if (first != -1) {
+    meas_.Replace(first, k, scratch_);  // Merged measurements do not count as processed
+  }
+  scratch_.clear();
+  runMeas_.clear();
 }
 
 void MeasurementTimeline::RemoveOutdated(const TimePoint& time) {
-  while (!meas_map_.empty() && meas_map_.begin()->first <= time) {
+  while (!meas_.Empty() && meas_.Front().t_ <= time) {
     LOG(WARNING) << "Removing outdated measurement at "
-                 << GIF::Print(meas_map_.begin()->first) << "(normal at beginning)." << std::endl;
+                 << GIF::Print(meas_.Front().t_) << "(normal at beginning)." << std::endl;
     RemoveProcessedFirst();
   }
 }
@@ -186,11 +413,11 @@ void MeasurementTimeline::RemoveOutdated(const TimePoint& time) {
 std::string MeasurementTimeline::Print(const TimePoint& start, int start_offset,
                                 double resolution) const {
   std::ostringstream out;
-  const int width = meas_map_.empty() ? start_offset : start_offset
-                    + ceil(toSec(meas_map_.rbegin()->first - start) / resolution) + 1;
+  const int width = meas_.Empty() ? start_offset : start_offset
+                    + ceil(toSec(meas_.Back().t_ - start) / resolution) + 1;
   std::vector<int> counts(width, 0);
-  for (auto it = meas_map_.begin(); it != meas_map_.end(); ++it) {
-    const int x = start_offset + ceil(toSec(it->first - start) / resolution);
+  for (int k = 0; k < meas_.Size(); k++) {
+    const int x = start_offset + ceil(toSec(meas_.At(k).t_ - start) / resolution);
     if (x >= 0) {
       counts.at(x)++;
     }
@@ -210,4 +437,40 @@ TimePoint MeasurementTimeline::GetLastProcessedTime() const{
   return last_processed_time_;
 }
 
+MeasurementQueue::MeasurementQueue(int capacity)
+    : entries_(NextPowerOfTwo(capacity)), mask_(entries_.size() - 1), head_(0), tail_(0) {
+}
+
+MeasurementQueue::~MeasurementQueue() {
+}
+
+bool MeasurementQueue::Push(const ElementVectorBase::CPtr& meas, const TimePoint& t) {
+  const size_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail - head_.load(std::memory_order_acquire) == entries_.size()) {
+    return false;  // Full
+  }
+  Entry& entry = entries_[tail & mask_];
+  entry.meas_ = meas;
+  entry.t_ = t;
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool MeasurementQueue::Pop(ElementVectorBase::CPtr& meas, TimePoint& t) {
+  const size_t head = head_.load(std::memory_order_relaxed);
+  if (head == tail_.load(std::memory_order_acquire)) {
+    return false;  // Empty
+  }
+  Entry& entry = entries_[head & mask_];
+  meas = std::move(entry.meas_);
+  entry.meas_.reset();
+  t = entry.t_;
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+int MeasurementQueue::GetCapacity() const {
+  return entries_.size();
+}
+
 }
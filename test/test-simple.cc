@@ -1,3 +1,6 @@
+#include <limits>
+#include <thread>
+
 #include "gtest/gtest.h"
 
 #include "../include/generalized_information_filter/element-vector.h"
@@ -11,6 +14,9 @@
 #include "generalized_information_filter/residuals/leg-kinematic-update.h"
 #include "generalized_information_filter/residuals/pose-update.h"
 #include "generalized_information_filter/residuals/random-walk-prediction.h"
+#include "generalized_information_filter/residuals/robocentric/attitude-findif.h"
+#include "generalized_information_filter/residuals/robocentric/imuacc-findif.h"
+#include "generalized_information_filter/residuals/robocentric/imuror-update.h"
 #include "generalized_information_filter/transformation.h"
 #include "generalized_information_filter/unary-update.h"
 
@@ -46,6 +52,7 @@ class BinaryRedidualVelocity : public BinaryResidual<ElementPack<Vec3>,
       : mtBinaryRedidual("velRes", { "pos" }, { "pos", "vel" }, { "pos" }, { "pos" },
                          false, false, false) {
     dt_ = 0.1;
+    evalCount_ = 0;
   }
 
   virtual ~BinaryRedidualVelocity() {}
@@ -53,6 +60,7 @@ class BinaryRedidualVelocity : public BinaryResidual<ElementPack<Vec3>,
   void Eval(Vec3& posRes, const Vec3& posPre, const Vec3& velPre,
                         const Vec3& posCur, const Vec3& posNoi) const {
     posRes = posPre + dt_ * velPre - posCur + posNoi;
+    evalCount_++;
   }
 
   void JacPre(MatX& J, const Vec3& posPre, const Vec3& velPre,
@@ -74,6 +82,8 @@ class BinaryRedidualVelocity : public BinaryResidual<ElementPack<Vec3>,
     GetJacBlockNoi<0, 0>(J) = Mat3::Identity();
   }
 
+  mutable int evalCount_;
+
  protected:
   double dt_;
 };
@@ -124,12 +134,46 @@ class BinaryRedidualAccelerometer : public BinaryResidual<ElementPack<Vec3>,
   double dt_;
 };
 
+// Mergeable residual on a manifold measurement (position and attitude)
+class BinaryRedidualPose : public BinaryResidual<ElementPack<Vec3>,
+    ElementPack<Vec3>, ElementPack<Vec3>, ElementPack<Vec3>, PoseMeas> {
+ public:
+  BinaryRedidualPose()
+      : mtBinaryRedidual("poseRes", { "pos" }, { "pos" }, { "pos" }, { "pos" }, false,
+                         true, true) {
+  }
+
+  virtual ~BinaryRedidualPose() {
+  }
+
+  void Eval(Vec3& posRes, const Vec3& posPre, const Vec3& posCur,
+                        const Vec3& posNoi) const {
+    posRes = posPre + meas_->JrJC_ - posCur + posNoi;
+  }
+  void JacPre(MatX& J, const Vec3& posPre, const Vec3& posCur,
+                  const Vec3& posNoi) const {
+    J.setZero();
+    GetJacBlockPre<0, 0>(J) = Mat3::Identity();
+  }
+  void JacCur(MatX& J, const Vec3& posPre, const Vec3& posCur,
+                  const Vec3& posNoi) const {
+    J.setZero();
+    GetJacBlockCur<0, 0>(J) = -Mat3::Identity();
+  }
+  void JacNoi(MatX& J, const Vec3& posPre, const Vec3& posCur,
+                  const Vec3& posNoi) const {
+    J.setZero();
+    GetJacBlockNoi<0, 0>(J) = Mat3::Identity();
+  }
+};
+
 class PredictionAccelerometer : public Prediction<ElementPack<Vec3>,
     ElementPack<Vec3>, AccelerometerMeas> {
  public:
   PredictionAccelerometer()
       : mtPrediction("accPre", { "vel" }, { "vel" }) {
     dt_ = 0.1;
+    predictCount_ = 0;
   }
 
   virtual ~PredictionAccelerometer() {}
@@ -137,6 +181,7 @@ class PredictionAccelerometer : public Prediction<ElementPack<Vec3>,
   void Predict(Vec3& velCur, const Vec3& velPre,
                           const Vec3& velNoi) const {
     velCur = velPre + dt_ * meas_->acc_ + velNoi;
+    predictCount_++;
   }
   void PredictJacPre(MatX& J, const Vec3& velPre,
                             const Vec3& velNoi) const {
@@ -149,17 +194,112 @@ class PredictionAccelerometer : public Prediction<ElementPack<Vec3>,
     GetJacBlockNoi<0, 0>(J) = Mat3::Identity();
   }
 
+  mutable int predictCount_;
+
  protected:
   double dt_;
 };
 
+class UnaryRedidualCalibration : public UnaryUpdate<ElementPack<Vec<12>>,
+    ElementPack<Vec3, Vec<12>>, ElementPack<Vec<12>>, AccelerometerMeas> {
+ public:
+  UnaryRedidualCalibration()
+      : mtUnaryUpdate("calRes", { "cal" }, { "vel", "cal" }, { "cal" }) {
+  }
+
+  virtual ~UnaryRedidualCalibration() {}
+
+  void Eval(Vec<12>& calRes, const Vec3& velCur, const Vec<12>& calCur,
+            const Vec<12>& calNoi) const {
+    calRes = calCur + calNoi;
+    for (int i = 0; i < 4; i++) {
+      calRes.segment<3>(3*i) -= (i+1) * (velCur + meas_->acc_);
+    }
+  }
+  void JacCur(MatX& J, const Vec3& velCur, const Vec<12>& calCur,
+              const Vec<12>& calNoi) const {
+    J.setZero();
+    GetJacBlockCur<0, 1>(J) = Mat<12>::Identity();
+    for (int i = 0; i < 4; i++) {
+      J.block<3, 3>(3*i, 0) = -(i+1) * Mat3::Identity();
+    }
+  }
+  void JacNoi(MatX& J, const Vec3& velCur, const Vec<12>& calCur,
+              const Vec<12>& calNoi) const {
+    J.setZero();
+    GetJacBlockNoi<0, 0>(J) = Mat<12>::Identity();
+  }
+};
+
+// Exposes the marginalized previous information D of the last update step
+class MarginalizationFilter : public Filter {
+ public:
+  MatX GetD() {
+    const int preDim = ComputeConnectedBlocks(preBlockStart_, true);
+    return ws_.D_.topLeftCorner(preDim, preDim);
+  }
+};
+
 // The fixture for testing class ScalarState
 class NewStateTest : public virtual ::testing::Test {
  protected:
   NewStateTest()
-      : covMat_(1, 1) {}
+      : covMat_(1, 1),
+        start_(Clock::now()),
+        eptMeas_(new EmptyMeas) {}
   virtual ~NewStateTest() {}
+
+  // Time of the i-th measurement (0.1s spacing)
+  TimePoint Time(int i) const {
+    return start_ + fromSec(0.1*i);
+  }
+  // Accelerometer signal of the i-th measurement
+  static Vec3 AccSignal(int i) {
+    return Vec3(0.1*i, -0.2, 0.05*i*i);
+  }
+  // Velocity model: velocity residual (index 0) and the given acceleration residual (index 1)
+  static void AddVelocityModel(Filter* f, const BinaryResidualBase::Ptr& accRes,
+                               const BinaryResidualBase::Ptr& velRes
+                                   = std::make_shared<BinaryRedidualVelocity>()) {
+    f->AddResidual(velRes, fromSec(0.1), fromSec(0.0));
+    f->AddResidual(accRes, fromSec(0.1), fromSec(0.0));
+  }
+  // Adds the measurements first to last of the velocity model and runs numUpdates updates
+  void RunVelocityModel(Filter* f, int first, int last, int numUpdates) {
+    for (int i = first; i <= last; i++) {
+      f->AddMeasurement(0, eptMeas_, Time(i));
+      f->AddMeasurement(1, std::make_shared<AccelerometerMeas>(AccSignal(i)), Time(i));
+    }
+    for (int k = 0; k < numUpdates; k++) {
+      f->Update();
+    }
+  }
+  // Without any update residual the velocity model integrates the acceleration signal (starting
+  // from zero at the first measurement)
+  void ExpectIntegratedVelocityModel(Filter& f, int first) {
+    Vec3 pos(0.0, 0.0, 0.0);
+    Vec3 vel(0.0, 0.0, 0.0);
+    for (int i = first + 1; Time(i) <= f.GetTime(); i++) {
+      pos += 0.1 * vel;
+      vel += 0.1 * AccSignal(i);
+    }
+    EXPECT_GT(f.GetTime(), Time(first));
+    const ElementVector& state = f.GetState();
+    EXPECT_NEAR((state.GetValue<Vec3>("pos") - pos).norm(), 0.0, 1e-8);
+    EXPECT_NEAR((state.GetValue<Vec3>("vel") - vel).norm(), 0.0, 1e-8);
+  }
+  static void ExpectSameEstimate(Filter& f, Filter& ref) {
+    EXPECT_TRUE(f.GetTime() == ref.GetTime());
+    VecX diff(ref.StateDefinition()->GetDim());
+    f.GetState().BoxMinus(ref.GetState(), diff);
+    EXPECT_NEAR(diff.norm(), 0.0, 1e-8);
+    const MatX cov = ref.GetCovariance();
+    EXPECT_NEAR((f.GetCovariance() - cov).norm(), 0.0, 1e-8 * cov.norm());
+  }
+
   MatX covMat_;
+  TimePoint start_;
+  std::shared_ptr<EmptyMeas> eptMeas_;
 };
 
 // Test constructors
@@ -328,6 +468,522 @@ TEST_F(NewStateTest, constructor) {
   legKinematicUpd->TestJacs(1e-6,1e-6);
 }
 
+// Test caching of the prediction between evaluation and Jacobians
+TEST_F(NewStateTest, predictionCache) {
+  std::shared_ptr<PredictionAccelerometer> accPre(new PredictionAccelerometer());
+  accPre->SetMeas(std::shared_ptr<AccelerometerMeas>(
+      new AccelerometerMeas(Vec3(0.1,0.0,0.0))));
+  ElementVector pre(accPre->PreDefinition());
+  ElementVector cur(accPre->CurDefinition());
+  ElementVector noi(accPre->NoiDefinition());
+  ElementVector inn(accPre->InnDefinition());
+  pre.SetIdentity();
+  cur.SetIdentity();
+  noi.SetIdentity();
+  MatX J(3,3);
+  BinaryResidualBase* res = accPre.get();
+
+  // Without input version every call recomputes the prediction
+  res->Eval(&inn, pre, cur, noi);
+  res->JacPre(J, pre, cur, noi);
+  res->JacCur(J, pre, cur, noi);
+  res->JacNoi(J, pre, cur, noi);
+  EXPECT_EQ(accPre->predictCount_, 4);
+
+  // Same input version: the prediction is computed once
+  res->SetInputVersion(BinaryResidualBase::NewInputVersion());
+  res->Eval(&inn, pre, cur, noi);
+  res->JacPre(J, pre, cur, noi);
+  res->JacCur(J, pre, cur, noi);
+  res->JacNoi(J, pre, cur, noi);
+  EXPECT_EQ(accPre->predictCount_, 5);
+
+  // New input version: the prediction is recomputed
+  res->SetInputVersion(BinaryResidualBase::NewInputVersion());
+  res->JacPre(J, pre, cur, noi);
+  res->JacNoi(J, pre, cur, noi);
+  EXPECT_EQ(accPre->predictCount_, 6);
+  res->SetInputVersion(0);
+
+  // Filter: a single prediction per update step (velRes is active at every update step)
+  std::shared_ptr<BinaryRedidualVelocity> velRes(new BinaryRedidualVelocity());
+  Filter f;
+  AddVelocityModel(&f, accPre, velRes);
+  accPre->predictCount_ = 0;
+  RunVelocityModel(&f, -1, 4, 2);
+  EXPECT_GT(velRes->evalCount_, 0);
+  EXPECT_EQ(accPre->predictCount_, velRes->evalCount_);
+}
+
+// Test the fused evaluation against the individual calls
+TEST_F(NewStateTest, fusedEvaluation) {
+  AttitudeFindif attRes("att");
+  BinaryResidualBase* res = &attRes;
+  res->SetDt(0.05);
+  ElementVector pre(res->PreDefinition());
+  ElementVector cur(res->CurDefinition());
+  ElementVector noi(res->NoiDefinition());
+  ElementVector inn1(res->InnDefinition());
+  ElementVector inn2(res->InnDefinition());
+  pre.SetRandom();
+  cur.SetRandom();
+  noi.SetRandom();
+  const int innDim = res->InnDefinition()->GetDim();
+  MatX JPre1(innDim, res->PreDefinition()->GetDim());
+  MatX JCur1(innDim, res->CurDefinition()->GetDim());
+  MatX JNoi1(innDim, res->NoiDefinition()->GetDim());
+  MatX JPre2(JPre1.rows(), JPre1.cols());
+  MatX JCur2(JCur1.rows(), JCur1.cols());
+  MatX JNoi2(JNoi1.rows(), JNoi1.cols());
+  res->Eval(&inn1, pre, cur, noi);
+  res->JacPre(JPre1, pre, cur, noi);
+  res->JacCur(JCur1, pre, cur, noi);
+  res->JacNoi(JNoi1, pre, cur, noi);
+  ASSERT_TRUE(res->EvalWithJacobians(&inn2, JPre2, JCur2, JNoi2, pre, cur, noi));
+  VecX diff(innDim);
+  inn2.BoxMinus(inn1, diff);
+  EXPECT_NEAR(diff.norm(), 0.0, 1e-12);
+  EXPECT_NEAR((JPre2 - JPre1).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((JCur2 - JCur1).norm(), 0.0, 1e-12);
+  EXPECT_NEAR((JNoi2 - JNoi1).norm(), 0.0, 1e-12);
+
+  // Residuals without fused implementation fall back to the individual calls
+  BinaryRedidualVelocity velRes;
+  ElementVector velPre(velRes.PreDefinition());
+  ElementVector velCur(velRes.CurDefinition());
+  ElementVector velNoi(velRes.NoiDefinition());
+  ElementVector velInn(velRes.InnDefinition());
+  EXPECT_FALSE(static_cast<BinaryResidualBase&>(velRes).EvalWithJacobians(
+      &velInn, JPre2, JCur2, JNoi2, velPre, velCur, velNoi));
+}
+
+// Test the square-root information filter against the information filter
+TEST_F(NewStateTest, squareRootSolver) {
+  Filter f1;
+  Filter f2;
+  f2.SetUpdateSolver(Filter::SOLVER_SQUARE_ROOT);
+  for (Filter* f : {&f1, &f2}) {
+    AddVelocityModel(f, std::make_shared<PredictionAccelerometer>());
+    RunVelocityModel(f, -1, 4, 2);
+  }
+  ExpectIntegratedVelocityModel(f2, -1);
+  ExpectSameEstimate(f2, f1);
+}
+
+// Test the marginal covariance of selected elements (in requested order) against the full one
+TEST_F(NewStateTest, marginalCovariance) {
+  Filter f1;
+  Filter f2;
+  f2.SetUpdateSolver(Filter::SOLVER_SQUARE_ROOT);
+  for (Filter* f : {&f1, &f2}) {
+    AddVelocityModel(f, std::make_shared<PredictionAccelerometer>());
+    RunVelocityModel(f, -1, 4, 2);
+    const MatX cov = f->GetCovariance();
+    const int posStart = f->StateDefinition()->GetStart(f->StateDefinition()->FindName("pos"));
+    const int velStart = f->StateDefinition()->GetStart(f->StateDefinition()->FindName("vel"));
+    const MatX margCov = f->GetMarginalCovariance({"vel", "pos"});
+    ASSERT_EQ(margCov.rows(), 6);
+    EXPECT_NEAR((margCov.block<3,3>(0,0) - cov.block<3,3>(velStart,velStart)).norm(), 0.0, 1e-8);
+    EXPECT_NEAR((margCov.block<3,3>(0,3) - cov.block<3,3>(velStart,posStart)).norm(), 0.0, 1e-8);
+    EXPECT_NEAR((margCov.block<3,3>(3,3) - cov.block<3,3>(posStart,posStart)).norm(), 0.0, 1e-8);
+  }
+}
+
+// Test that queries reuse the factorization of the information and writing to it invalidates it
+TEST_F(NewStateTest, informationVersion) {
+  Filter f;
+  AddVelocityModel(&f, std::make_shared<PredictionAccelerometer>());
+  RunVelocityModel(&f, -1, 4, 2);
+  const int stateDim = f.StateDefinition()->GetDim();
+  const unsigned long version = f.GetInformationVersion();
+  const MatX cov = f.GetInformationLDLT().solve(MatX::Identity(stateDim, stateDim));
+  EXPECT_NEAR((cov - f.GetCovariance()).norm(), 0.0, 1e-8);
+  EXPECT_EQ(version, f.GetInformationVersion());
+  f.GetNoiseInfBlock("pos") *= 2.0;
+  EXPECT_NE(version, f.GetInformationVersion());
+}
+
+// Test the factorized update against the explicit inverses
+TEST_F(NewStateTest, factorizedSolver) {
+  Filter f1;
+  Filter f2;
+  f2.SetUpdateSolver(Filter::SOLVER_FACTORIZED);
+  for (Filter* f : {&f1, &f2}) {
+    AddVelocityModel(f, std::make_shared<BinaryRedidualAccelerometer>());
+    RunVelocityModel(f, -1, 6, 4);
+  }
+  ExpectIntegratedVelocityModel(f2, -1);
+  VecX diff(f1.StateDefinition()->GetDim());
+  f2.GetState().BoxMinus(f1.GetState(), diff);
+  EXPECT_NEAR(diff.norm(), 0.0, 1e-8);
+  const MatX inf1 = f1.GetInformationLDLT().reconstructedMatrix();
+  const MatX inf2 = f2.GetInformationLDLT().reconstructedMatrix();
+  EXPECT_NEAR((inf2 - inf1).norm(), 0.0, 1e-8 * inf1.norm());
+}
+
+// Test the marginalization of the unconnected previous blocks and the random walk shortcut against
+// the square-root solver (which always works on the full previous state)
+TEST_F(NewStateTest, connectedMarginalization) {
+  for (int setup = 0; setup < 2; setup++) {
+    Filter f1;
+    Filter f2;
+    Filter f3;
+    f2.SetUpdateSolver(Filter::SOLVER_FACTORIZED);
+    f3.SetUpdateSolver(Filter::SOLVER_SQUARE_ROOT);
+    Filter* filters[3] = {&f1, &f2, &f3};
+    for (Filter* f : filters) {
+      f->AddResidual(std::make_shared<PredictionAccelerometer>(),fromSec(0.1),fromSec(0.0));
+      if (setup == 0) {
+        // Previous cal is never connected, and only dominates the connected vel
+        f->AddResidual(std::make_shared<UnaryRedidualCalibration>(),fromSec(0.1),fromSec(0.0));
+      } else {
+        f->AddResidual(std::make_shared<BinaryRedidualVelocity>(),fromSec(0.1),fromSec(0.0));
+        std::shared_ptr<RandomWalkPrediction<ElementPack<Vec3,Quat>>> extPre(
+            new RandomWalkPrediction<ElementPack<Vec3,Quat>>("ExtPre", {"IrIJ", "qIJ"},
+                                                             {"IrIJ", "qIJ"}));
+        EXPECT_TRUE(extPre->isRandomWalk_);
+        f->AddResidual(extPre,fromSec(0.1),fromSec(0.0));
+      }
+    }
+    const int stateDim = f1.StateDefinition()->GetDim();
+    const MatX A = MatX::Random(stateDim, stateDim);
+    const MatX cov = A * A.transpose() + MatX::Identity(stateDim, stateDim);
+    TimePoint covTime;
+    for (int i = -1; i <= 6; i++) {
+      for (Filter* f : filters) {
+        f->AddMeasurement(0, std::make_shared<AccelerometerMeas>(AccSignal(i)), Time(i));
+        if (setup == 0) {
+          f->AddMeasurement(1, std::make_shared<AccelerometerMeas>(Vec3(0.3,0.1*i,0.0)), Time(i));
+        } else {
+          f->AddMeasurement(1, eptMeas_, Time(i));
+          f->AddMeasurement(2, eptMeas_, Time(i));
+        }
+        f->Update();
+        if (i == 1) {
+          // Correlate all previous blocks
+          f->SetCovariance(cov);
+          covTime = f->GetTime();
+        }
+      }
+    }
+    EXPECT_GT(f3.GetTime(), Time(4));
+    for (int j = 0; j < 2; j++) {
+      ExpectSameEstimate(*filters[j], f3);
+    }
+    if (setup == 1) {
+      // The unobserved random walk only accumulates its process noise (dt * R, with R = I)
+      const int start = f1.StateDefinition()->GetStart(f1.StateDefinition()->FindName("IrIJ"));
+      const MatX expected = cov.block<3,3>(start, start)
+          + toSec(f1.GetTime() - covTime) * Mat3::Identity();
+      for (Filter* f : filters) {
+        EXPECT_NEAR((f->GetMarginalCovariance({"IrIJ"}) - expected).norm(), 0.0,
+                    1e-8 * expected.norm());
+      }
+    }
+  }
+}
+
+// Test that marginalizing through the factorization of inf and the Schur complement yield the same D
+TEST_F(NewStateTest, marginalizationBranches) {
+  MarginalizationFilter f1;
+  MarginalizationFilter f2;
+  f1.SetMarginalizationRatio(0.0);  // Factorization of inf whenever it is up to date
+  f2.SetMarginalizationRatio(std::numeric_limits<double>::infinity());  // Always Schur complement
+  for (MarginalizationFilter* f : {&f1, &f2}) {
+    f->AddResidual(std::make_shared<PredictionAccelerometer>(),fromSec(0.1),fromSec(0.0));
+    f->AddResidual(std::make_shared<UnaryRedidualCalibration>(),fromSec(0.1),fromSec(0.0));
+  }
+  for (int i = -1; i <= 4; i++) {
+    for (MarginalizationFilter* f : {&f1, &f2}) {
+      f->AddMeasurement(0, std::make_shared<AccelerometerMeas>(AccSignal(i)), Time(i));
+      f->AddMeasurement(1, std::make_shared<AccelerometerMeas>(Vec3(0.3,0.1*i,0.0)), Time(i));
+      f->Update();
+    }
+    if (i >= 1) {
+      // Only vel is connected in the previous state, the unconnected cal is correlated with it
+      const MatX D1 = f1.GetD();
+      EXPECT_EQ(D1.rows(), 3);
+      EXPECT_NEAR((D1 - f2.GetD()).norm(), 0.0, 1e-8 * D1.norm());
+    }
+  }
+}
+
+// Test the lock-free measurement queue and the threaded ingestion
+TEST_F(NewStateTest, measurementQueue) {
+  MeasurementQueue queue(3);
+  EXPECT_EQ(queue.GetCapacity(), 4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.Push(eptMeas_, Time(i)));
+  }
+  EXPECT_FALSE(queue.Push(eptMeas_, Time(4)));
+  ElementVectorBase::CPtr meas;
+  TimePoint t;
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.Pop(meas, t));
+    EXPECT_EQ(t, Time(i));
+  }
+  EXPECT_FALSE(queue.Pop(meas, t));
+
+  // One producer thread per residual
+  std::shared_ptr<BinaryRedidualVelocity> velRes(new BinaryRedidualVelocity());
+  std::shared_ptr<PredictionAccelerometer> accPre(new PredictionAccelerometer());
+  Filter f;
+  f.AddResidual(velRes,fromSec(0.1),fromSec(0.0),16);
+  f.AddResidual(accPre,fromSec(0.1),fromSec(0.0),16);
+  std::thread velThread([&]() {
+    for (int i = -1; i <= 4; i++) {
+      f.PushMeasurement(0, eptMeas_, Time(i));
+    }
+  });
+  std::thread accThread([&]() {
+    for (int i = -1; i <= 4; i++) {
+      f.PushMeasurement(1, std::make_shared<AccelerometerMeas>(AccSignal(i)), Time(i));
+    }
+  });
+  velThread.join();
+  accThread.join();
+  f.Update();
+  EXPECT_TRUE(f.IsInitialized());
+  EXPECT_GT(velRes->evalCount_, 0);
+  ExpectIntegratedVelocityModel(f, -1);
+}
+
+TEST_F(NewStateTest, measurementPool) {
+  {
+    std::shared_ptr<ImuMeas> meas = MeasurementPool<ImuMeas>::Make(Vec3(1.0, 2.0, 3.0),
+                                                                   Vec3(4.0, 5.0, 6.0));
+    EXPECT_EQ(meas->MwM_, Vec3(1.0, 2.0, 3.0));
+    EXPECT_EQ(meas->MfM_, Vec3(4.0, 5.0, 6.0));
+  }
+
+  // Released measurements are recycled
+  const int numAllocated = MeasurementPool<ImuMeas>::GetNumAllocated();
+  for (int i = 0; i < 10; i++) {
+    std::shared_ptr<ImuMeas> meas = MeasurementPool<ImuMeas>::Make(Vec3(0.1, 0.2, 0.3),
+                                                                   Vec3(0.4, 0.5, 0.6));
+    EXPECT_EQ(meas->MwM_, Vec3(0.1, 0.2, 0.3));
+    EXPECT_EQ(meas->MfM_, Vec3(0.4, 0.5, 0.6));
+  }
+  EXPECT_EQ(MeasurementPool<ImuMeas>::GetNumAllocated(), numAllocated);
+
+  // Exhausted pool allocates new measurements, which join the pool on release
+  std::vector<std::shared_ptr<ImuMeas>> held;
+  for (int i = 0; i < numAllocated + 2; i++) {
+    held.push_back(MeasurementPool<ImuMeas>::Make(Vec3::Zero(), Vec3::Zero()));
+  }
+  EXPECT_EQ(MeasurementPool<ImuMeas>::GetNumAllocated(), numAllocated + 2);
+  held.clear();
+  for (int i = 0; i < numAllocated + 2; i++) {
+    held.push_back(MeasurementPool<ImuMeas>::Make(Vec3::Zero(), Vec3::Zero()));
+  }
+  EXPECT_EQ(MeasurementPool<ImuMeas>::GetNumAllocated(), numAllocated + 2);
+  held.clear();
+
+  // Recycled measurements do not leak the content of their previous use
+  MeasurementPool<RorMeas>::Make(Vec3(1.0, 2.0, 3.0))->SetRandom();
+  const int numAllocatedRor = MeasurementPool<RorMeas>::GetNumAllocated();
+  std::shared_ptr<RorMeas> meas = MeasurementPool<RorMeas>::Make(Vec3(1.0, 2.0, 3.0));
+  EXPECT_EQ(MeasurementPool<RorMeas>::GetNumAllocated(), numAllocatedRor);
+  EXPECT_EQ(meas->MwM_, Vec3(1.0, 2.0, 3.0));
+  EXPECT_EQ(meas->GetValue<Vec3>(1), Vec3::Zero());
+
+  // Measurements produced on another thread are recycled by the consuming thread
+  std::vector<std::shared_ptr<ImuMeas>> produced;
+  std::thread producer([&produced]() {
+    for (int i = 0; i < 100; i++) {
+      produced.push_back(MeasurementPool<ImuMeas>::Make(Vec3::Constant(i), Vec3::Zero()));
+    }
+  });
+  producer.join();
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(produced[i]->MwM_, Vec3::Constant(i));
+  }
+  produced.clear();
+  const int numAllocatedProduced = MeasurementPool<ImuMeas>::GetNumAllocated();
+  for (int i = 0; i < 100; i++) {
+    held.push_back(MeasurementPool<ImuMeas>::Make(Vec3::Zero(), Vec3::Zero()));
+  }
+  EXPECT_EQ(MeasurementPool<ImuMeas>::GetNumAllocated(), numAllocatedProduced);
+}
+
+TEST_F(NewStateTest, measurementRuns) {
+  BinaryRedidualAccelerometer accRes;
+  MeasurementTimeline mt(true, fromSec(0.1), fromSec(0.0));
+  TimePoint start = Clock::now();
+  for (int i = 0; i <= 4; i++) {
+    mt.AddMeasurement(std::make_shared<AccelerometerMeas>(Vec3(i, 0.0, 0.0)),
+                      start + fromSec(0.1*i));
+  }
+
+  // Merging the whole run yields the time-weighted mean
+  mt.MergeUndesired({start + fromSec(0.4)}, &accRes);
+  ElementVectorBase::CPtr meas;
+  EXPECT_FALSE(mt.GetMeasurement(start + fromSec(0.2), meas));
+  ASSERT_TRUE(mt.GetMeasurement(start + fromSec(0.4), meas));
+  EXPECT_NEAR(std::dynamic_pointer_cast<const AccelerometerMeas>(meas)->acc_(0), 2.5, 1e-9);
+
+  // Splitting inserts all times at once
+  mt.Split({start + fromSec(0.1), start + fromSec(0.3)}, &accRes);
+  ASSERT_TRUE(mt.GetMeasurement(start + fromSec(0.1), meas));
+  EXPECT_NEAR(std::dynamic_pointer_cast<const AccelerometerMeas>(meas)->acc_(0), 2.5, 1e-9);
+  EXPECT_TRUE(mt.GetMeasurement(start + fromSec(0.3), meas));
+  EXPECT_TRUE(mt.GetMeasurement(start + fromSec(0.4), meas));
+  EXPECT_FALSE(mt.GetMeasurement(start + fromSec(0.2), meas));
+
+  // Run merging agrees with pairwise merging, for vector spaces and manifolds
+  const TimePoint t0 = start - fromSec(0.1);
+  const std::vector<TimePoint> times({start, start + fromSec(0.1), start + fromSec(0.3)});
+  std::vector<ElementVectorBase::CPtr> accRun;
+  std::vector<ElementVectorBase::CPtr> poseRun;
+  for (int i = 0; i < times.size(); i++) {
+    accRun.push_back(std::make_shared<AccelerometerMeas>(Vec3(i, 2.0*i*i, -1.0)));
+    Quat q = q.exponentialMap((i == 1) ? Vec3(1.0, 0.0, 0.0) : Vec3(0.0, 0.0, 1.0*i));
+    poseRun.push_back(std::make_shared<PoseMeas>(Vec3(i, 2.0*i*i, -1.0), q));
+  }
+  BinaryRedidualPose poseRes;
+  for (auto entry : {std::make_pair(static_cast<BinaryResidualBase*>(&accRes), &accRun),
+                     std::make_pair(static_cast<BinaryResidualBase*>(&poseRes), &poseRun)}) {
+    ElementVectorBase::CPtr merged;
+    ElementVectorBase::CPtr mergedPairwise;
+    entry.first->MergeMeasurementRun(t0, times, *entry.second, merged);
+    entry.first->BinaryResidualBase::MergeMeasurementRun(t0, times, *entry.second, mergedPairwise);
+    VecX diff(merged->GetDim());
+    merged->BoxMinus(*mergedPairwise, diff);
+    EXPECT_NEAR(diff.norm(), 0.0, 1e-9);
+  }
+}
+
+TEST_F(NewStateTest, imuPreintegration) {
+  TimePoint start = Clock::now();
+  const std::vector<TimePoint> times = {start + fromSec(0.1), start + fromSec(0.3)};
+
+  // Accelerometer: mean and first moment about the interval center
+  ImuaccFindif accRes("acc");
+  EXPECT_TRUE(accRes.TestJacs(1e-6, 1e-6));
+  ElementVectorBase::CPtr merged;
+  accRes.MergeMeasurementRun(start, times, {MeasurementPool<AccMeas>::Make(Vec3(3.0, 0.0, 0.0)),
+      MeasurementPool<AccMeas>::Make(Vec3(0.0, 0.0, 0.0))}, merged);
+  const AccMeas& acc = static_cast<const AccMeas&>(*merged);
+  EXPECT_NEAR(acc.MfM_(0), 1.0, 1e-9);
+  EXPECT_NEAR(acc.MfM_mom_(0), -0.5 * 0.1 * 0.2 * 3.0 / 0.3, 1e-9);
+
+  // Moment of a piecewise constant input against its analytic integral
+  const std::vector<TimePoint> stepTimes = {start + fromSec(0.1), start + fromSec(0.15),
+                                            start + fromSec(0.4)};
+  const std::vector<Vec3> steps = {Vec3(3.0, -1.0, 0.5), Vec3(-2.0, 4.0, 0.0),
+                                   Vec3(1.0, 0.5, -3.0)};
+  std::vector<ElementVectorBase::CPtr> stepMeas;
+  Vec3 moment(0.0, 0.0, 0.0);
+  double previous = 0.0;
+  for (int k = 0; k < steps.size(); k++) {
+    stepMeas.push_back(MeasurementPool<AccMeas>::Make(steps[k]));
+    const double current = toSec(stepTimes[k] - start);
+    moment += steps[k] * (std::pow(current - 0.2, 2) - std::pow(previous - 0.2, 2)) / (2.0 * 0.4);
+    previous = current;
+  }
+  accRes.MergeMeasurementRun(start, stepTimes, stepMeas, merged);
+  EXPECT_NEAR((static_cast<const AccMeas&>(*merged).MfM_mom_ - moment).norm(), 0.0, 1e-9);
+
+  // Gyroscope: rate of the accumulated delta-rotation
+  ImurorUpdate rorRes("ror");
+  rorRes.MergeMeasurementRun(start, times, {MeasurementPool<RorMeas>::Make(Vec3(0.0, 0.0, 1.0)),
+      MeasurementPool<RorMeas>::Make(Vec3(0.0, 0.0, 1.0))}, merged);
+  EXPECT_NEAR((static_cast<const RorMeas&>(*merged).MwM_ - Vec3(0.0, 0.0, 1.0)).norm(), 0.0, 1e-9);
+  rorRes.MergeMeasurementRun(start, times, {MeasurementPool<RorMeas>::Make(Vec3(1.0, 0.0, 0.0)),
+      MeasurementPool<RorMeas>::Make(Vec3(0.0, 1.0, 0.0))}, merged);
+  EXPECT_GT(std::fabs(static_cast<const RorMeas&>(*merged).MwM_(2)), 1e-4);  // Coning
+
+  // One merged step against the unmerged sub-steps (body rotating about the gravity axis with a
+  // varying specific force), the moment accounts for the rotation within the merged interval
+  const int N = 10;
+  const double dtSub = 0.01;
+  const Vec3 MwM(0.0, 0.0, 2.0);
+  std::vector<TimePoint> subTimes;
+  std::vector<ElementVectorBase::CPtr> subMeas;
+  Vec3 MvM_sub(0.0, 0.0, 0.0);
+  Quat qIM(1.0, 0.0, 0.0, 0.0);
+  Vec3 MvM_inn;
+  accRes.SetDt(dtSub);
+  for (int k = 0; k < N; k++) {
+    subTimes.push_back(start + fromSec(dtSub*(k+1)));
+    subMeas.push_back(MeasurementPool<AccMeas>::Make(Vec3(3.0*(k-4.5)/4.5, 0.0, 9.81)));
+    accRes.SetMeas(subMeas.back());
+    accRes.Eval(MvM_inn, MvM_sub, MwM, Vec3::Zero(), qIM, Vec3::Zero(), Vec3::Zero());
+    MvM_sub = MvM_inn;
+    Quat dQ = dQ.exponentialMap(dtSub * MwM);
+    qIM = qIM * dQ;
+  }
+  accRes.MergeMeasurementRun(start, subTimes, subMeas, merged);
+  accRes.SetDt(N*dtSub);
+  accRes.SetMeas(merged);
+  accRes.Eval(MvM_inn, Vec3::Zero(), MwM, Vec3::Zero(), Quat(1.0, 0.0, 0.0, 0.0), Vec3::Zero(),
+              Vec3::Zero());
+  const double mergedError = (MvM_inn - MvM_sub).norm();
+  accRes.SetMeas(MeasurementPool<AccMeas>::Make(static_cast<const AccMeas&>(*merged).MfM_));
+  accRes.Eval(MvM_inn, Vec3::Zero(), MwM, Vec3::Zero(), Quat(1.0, 0.0, 0.0, 0.0), Vec3::Zero(),
+              Vec3::Zero());
+  const double averagedError = (MvM_inn - MvM_sub).norm();
+  EXPECT_NEAR(mergedError, 0.0, 2e-3);
+  EXPECT_LT(mergedError, 0.1 * averagedError);
+}
+
+TEST_F(NewStateTest, measurementBuffer) {
+  MeasurementBuffer buffer(2);
+  std::shared_ptr<EmptyMeas> eptMeas(new EmptyMeas);
+  TimePoint start = Clock::now();
+  for (int i : {0, 2, 4, 5, 1, 3}) {
+    const TimePoint t = start + fromSec(0.1*i);
+    if (buffer.Empty() || buffer.Back().t_ < t) {
+      buffer.PushBack(t, eptMeas);
+    } else {
+      buffer.Insert(buffer.LowerBound(t), t, eptMeas);
+    }
+  }
+  ASSERT_EQ(buffer.Size(), 6);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(buffer.At(i).t_, start + fromSec(0.1*i));
+  }
+  EXPECT_EQ(buffer.Find(start + fromSec(0.3)), 3);
+  EXPECT_EQ(buffer.Find(start + fromSec(0.35)), -1);
+  EXPECT_EQ(buffer.UpperBound(start + fromSec(0.3)), 4);
+  buffer.PopFront();
+  buffer.Erase(1);
+  ASSERT_EQ(buffer.Size(), 4);
+  EXPECT_EQ(buffer.Front().t_, start + fromSec(0.1));
+  EXPECT_EQ(buffer.At(1).t_, start + fromSec(0.3));
+  EXPECT_EQ(buffer.Back().t_, start + fromSec(0.5));
+}
+
+// Test batched boxplus/boxminus against the element-wise implementation
+TEST_F(NewStateTest, boxOperations) {
+  ElementVectorDefinition::Ptr def(new ElementVectorDefinition());
+  def->AddElement<double>("a");
+  def->AddElement<Quat>("q0");
+  def->AddElement<Vec3>("b");
+  def->AddElement<std::array<Vec3, 2>>("c");
+  for (int i = 1; i < 6; i++) {
+    def->AddElement<Quat>("q" + std::to_string(i));
+  }
+  def->AddElement<Vec<4>>("d");
+  ElementVector s1(def);
+  ElementVector s2(def);
+  ElementVector s3(def);
+  s1.SetRandom();
+  VecX dx(def->GetDim());
+  dx.setRandom();
+  dx.segment<3>(def->GetStart(def->FindName("q2"))).setZero();
+  s1.BoxPlus(dx, &s2);
+  for (int i = 0; i < s1.GetNumElement(); i++) {
+    s1.GetElement(i)->Boxplus(dx.segment(s1.GetStart(i), s1.GetElement(i)->GetDim()),
+                              s3.GetElement(i));
+  }
+  VecX diff(def->GetDim());
+  s2.BoxMinus(s3, diff);
+  EXPECT_NEAR(diff.norm(), 0.0, 1e-10);
+  s2.BoxMinus(s1, diff);
+  EXPECT_NEAR((diff - dx).norm(), 0.0, 1e-10);
+}
+
 int main(int argc, char **argv) {
   google::InitGoogleLogging(argv[0]);
   ::testing::InitGoogleTest(&argc, argv);